@@ -5,6 +5,19 @@
 #include <vector>
 #include <set>
 #include <list>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using std::pair;
 using std::max;
@@ -17,126 +30,761 @@ typedef pair<short, short> node_t;
 // (depth, span)
 typedef pair<short, short> tree_data_t;
 
+// DFS stack frame: node, next move and two deepest children
+struct dfs_frame_t {
+    int cell;
+    short move;
+    short x;
+    int max_depth1;
+    int max_depth2;
+};
+
+/**
+ * Bulk reader of stdin. Regular file is mapped into memory at once,
+ * pipe is read in large blocks. Numbers and words are parsed straight
+ * from the buffer, no library call per token.
+ */
+class InputReader {
+public:
+    InputReader() : pos_(NULL), end_(NULL), mapped_(NULL), mapped_size_(0) {
+        struct stat info;
+        off_t offset = lseek(0, 0, SEEK_CUR);
+        if (fstat(0, &info) == 0 && S_ISREG(info.st_mode) && offset >= 0 && info.st_size > offset) {
+            void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, 0, 0);
+            if (data != MAP_FAILED) {
+                mapped_ = static_cast<char*>(data);
+                mapped_size_ = info.st_size;
+                pos_ = mapped_ + offset;
+                end_ = mapped_ + mapped_size_;
+            }
+        }
+    }
+
+    ~InputReader() {
+        if (mapped_ != NULL)
+            munmap(mapped_, mapped_size_);
+    }
+
+    /**
+     * Reads signed decimal number, like scanf("%d")
+     */
+    int ReadInt() {
+        SkipSpaces();
+        bool negative = false;
+        if (Peek() == '-' || Peek() == '+') {
+            negative = (*pos_ == '-');
+            ++pos_;
+        }
+        int value = 0;
+        for (int c = Peek(); c >= '0' && c <= '9'; c = Peek()) {
+            value = value * 10 + (c - '0');
+            ++pos_;
+        }
+        return negative ? -value : value;
+    }
+
+    /**
+     * Reads word into buffer, like scanf("%s"), returns its length
+     */
+    std::size_t ReadWord(char* word) {
+        SkipSpaces();
+        std::size_t length = 0;
+        for (int c = Peek(); c != EOF && c > ' '; c = Peek()) {
+            // Copy whole run of non space characters available in buffer
+            const char* run = pos_;
+            while (run != end_ && static_cast<unsigned char>(*run) > ' ')
+                ++run;
+            std::memcpy(word + length, pos_, run - pos_);
+            length += run - pos_;
+            pos_ = run;
+        }
+        word[length] = '\0';
+        return length;
+    }
+
+private:
+    static const std::size_t BLOCK_SIZE = 1 << 16;
+
+    inline int Peek() {
+        if (pos_ == end_ && !Refill())
+            return EOF;
+        return static_cast<unsigned char>(*pos_);
+    }
+
+    inline void SkipSpaces() {
+        for (int c = Peek(); c != EOF && c <= ' '; c = Peek())
+            ++pos_;
+    }
+
+    bool Refill() {
+        if (mapped_ != NULL)
+            return false;
+        ssize_t count = read(0, block_, BLOCK_SIZE);
+        if (count <= 0)
+            return false;
+        pos_ = block_;
+        end_ = block_ + count;
+        return true;
+    }
+
+// Data
+private:
+    const char* pos_;
+    const char* end_;
+    char* mapped_;
+    std::size_t mapped_size_;
+    char block_[BLOCK_SIZE];
+} input;
+
+/**
+ * Bulk writer to stdout. Output is formatted into large buffer and
+ * written out only when buffer fills up and at exit. Small numbers
+ * are copied from precomputed table of their digits. Writer given
+ * a string collects output there instead, to be written later.
+ */
+class OutputWriter {
+public:
+    explicit OutputWriter(std::string* capture = NULL) : pos_(buffer_), capture_(capture) {
+        for (int value = 0; value < SMALL_INTS; ++value) {
+            int length = 0;
+            for (int rest = value; rest > 0 || length == 0; rest /= 10)
+                ++length;
+            small_lengths_[value] = length;
+            for (int i = length-1, rest = value; i >= 0; --i, rest /= 10)
+                small_digits_[value][i] = '0' + rest % 10;
+        }
+    }
+
+    ~OutputWriter() {
+        Flush();
+    }
+
+    inline void WriteInt(int value) {
+        if (pos_ + MAX_INT_LENGTH > buffer_ + BUFFER_SIZE)
+            Flush();
+        if (value >= 0 && value < SMALL_INTS) {
+            std::memcpy(pos_, small_digits_[value], SMALL_DIGITS);
+            pos_ += small_lengths_[value];
+            return;
+        }
+        unsigned int rest = value;
+        if (value < 0) {
+            *pos_++ = '-';
+            rest = -rest;
+        }
+        char digits[MAX_INT_LENGTH];
+        int length = 0;
+        do {
+            digits[length++] = '0' + rest % 10;
+            rest /= 10;
+        } while (rest > 0);
+        while (length > 0)
+            *pos_++ = digits[--length];
+    }
+
+    inline void WriteChar(char c) {
+        if (pos_ == buffer_ + BUFFER_SIZE)
+            Flush();
+        *pos_++ = c;
+    }
+
+    void WriteString(const char* text) {
+        for (; *text != '\0'; ++text)
+            WriteChar(*text);
+    }
+
+    void Write(const std::string& text) {
+        if (pos_ + text.size() > buffer_ + BUFFER_SIZE)
+            Flush();
+        if (text.size() > (std::size_t)BUFFER_SIZE) {
+            WriteOut(text.data(), text.data() + text.size());
+            return;
+        }
+        std::memcpy(pos_, text.data(), text.size());
+        pos_ += text.size();
+    }
+
+    void Flush() {
+        WriteOut(buffer_, pos_);
+        pos_ = buffer_;
+    }
+
+private:
+    void WriteOut(const char* data, const char* end) {
+        if (capture_ != NULL) {
+            capture_->append(data, end);
+            return;
+        }
+        while (data < end) {
+            ssize_t count = write(1, data, end - data);
+            if (count <= 0)
+                break;
+            data += count;
+        }
+    }
+
+    static const int BUFFER_SIZE = 1 << 16;
+    static const int MAX_INT_LENGTH = 12;
+    static const int SMALL_INTS = 1000;
+    static const int SMALL_DIGITS = 4;
+
+// Data
+private:
+    char* pos_;
+    std::string* capture_;
+    char buffer_[BUFFER_SIZE];
+    char small_digits_[SMALL_INTS][SMALL_DIGITS];
+    char small_lengths_[SMALL_INTS];
+} output;
+
 class Algorithm {
-    const static int GRID_SIZE = 1000;
+public:
+    // Rope length from DFS keeping two deepest children, or from
+    // double sweep BFS
+    enum Engine { ENGINE_DFS, ENGINE_SWEEP };
+
+    // Connected component of free cells: its first cell in row major
+    // order, number of cells, longest path and number of independent
+    // cycles, edges - cells + 1
+    struct component_t {
+        int first;
+        int size;
+        int longest;
+        int cycles;
+    };
 
-    char grid_[GRID_SIZE][GRID_SIZE];
-    bool visited_[GRID_SIZE][GRID_SIZE];
-    //node_t parent_[GRID_SIZE][GRID_SIZE];
+    // Result of BFS sweep: last cell of last level and its distance,
+    // number of cells reached and sum of their free neighbours
+    struct sweep_t {
+        int farthest;
+        int distance;
+        int cells;
+        long long degrees;
+    };
+
+private:
+    // Grid row major with border of blocked cells around, so cell
+    // (row, column) is at (row+1) * pitch_ + column+1 and each cell
+    // of maze has all four neighbours in grid_
+    vector<char> grid_;
+
+    // Visited cells, bit per cell of grid_, only part used by
+    // current case is cleared
+    vector<uint64_t> visited_;
 
     int rows_count_;
     int columns_count_;
+    int pitch_;
     int rope;
 
+    // First free cell in row major order, -1 if there is none
+    int start_;
+
+    // Explicit DFS stack, reused between test cases
+    vector<dfs_frame_t> dfs_stack_;
+
+    // BFS queue, ring buffer of cells with capacity power of 2,
+    // doubled when full and reused between test cases
+    vector<int> queue_;
+
+    const static int QUEUE_SIZE = 1 << 12;
+
+    // Engine used by run()
+    Engine engine_;
+
+    // Every component is measured, not only the one of first free cell
+    bool components_mode_;
+
+    // Components with cycles get exact diameter instead of double
+    // sweep, which is exact for trees only
+    bool exact_mode_;
+
+    // Independent cycles of measured components
+    long long cycles_;
+
+    // Cells of last recorded BFS in visit order, and start of each
+    // level in it, last entry is number of cells
+    vector<int> order_;
+    vector<int> level_start_;
+
+    // Bounds of eccentricity of cells, and cells which can still move
+    // bounds of exact diameter
+    vector<int> ecc_lower_;
+    vector<int> ecc_upper_;
+    vector<int> candidates_;
+
+    // Mark of cells not yet visited by next BFS over swept component
+    char sweep_mark_;
+
+    // Threads labeling components, each takes band of rows
+    int threads_count_;
+
+    // Union-find parent of each free cell, root is the lowest cell of
+    // component. After labeling root holds -1 - component index.
+    vector<int> parent_;
+
+    // Components in order of their first cell
+    vector<component_t> components_;
+
     const static char BLOCKED = '#';
     const static char FREE = '.';
 
-    int dfsVisit(short node_row, short node_column, short x);
-    inline bool isBlocked(int row, int column);
+    // Marks of free cells visited by first and second BFS sweep
+    const static char FIRST_SWEEP = '1';
+    const static char SECOND_SWEEP = '2';
+
+    int dfsVisit(int node, short x);
+    sweep_t bfsSweep(int node, char unvisited, char visited, bool record);
+    int measureComponent(int first, int* cycles);
+    sweep_t bfsAgain(int node, bool record);
+    int exactDiameter(int end, int length);
+    void clearVisited();
+    void labelComponents();
+    void labelBand(int first_row, int last_row);
+
+    inline int findRoot(int cell) {
+        while (parent_[cell] != cell) {
+            parent_[cell] = parent_[parent_[cell]];
+            cell = parent_[cell];
+        }
+        return cell;
+    }
+
+    inline void unite(int a, int b) {
+        a = findRoot(a);
+        b = findRoot(b);
+        if (a < b)
+            parent_[b] = a;
+        else
+            parent_[a] = b;
+    }
+    inline bool isBlocked(int cell);
+
+    inline bool visited(int cell) {
+        return (visited_[cell >> 6] >> (cell & 63)) & 1;
+    }
+
+    inline void markVisited(int cell) {
+        visited_[cell >> 6] |= uint64_t(1) << (cell & 63);
+    }
 
 public:
+    void setEngine(Engine engine) {
+        engine_ = engine;
+    }
+
+    void setComponentsMode(bool components_mode, int threads_count) {
+        components_mode_ = components_mode;
+        threads_count_ = threads_count;
+    }
+
+    void setExactMode(bool exact_mode) {
+        exact_mode_ = exact_mode;
+    }
+
     void readInput();
     void run();
-    void printOutput();
+    void printOutput(OutputWriter& out);
 } algo;
 
 
-int Algorithm::dfsVisit(short node_row, short node_column, short x) {
+/**
+ * Iterative DFS from given node computing tree depth and rope span,
+ * frames hold the next move and two deepest children of each node
+ */
+int Algorithm::dfsVisit(int node, short x) {
 
-    visited_[node_row][node_column] = true;
-    int max_depth1 = 0;
-    int max_depth2 = 0;
+    dfs_stack_.clear();
+    markVisited(node);
+    dfs_frame_t root = { node, 0, x, 0, 0 };
+    dfs_stack_.push_back(root);
 
-    // For each children
-    int delta[][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
-    for (int move = 0; move < 4; ++move) {
+    int depth = 0;
+    const int delta[] = { -pitch_, pitch_, -1, 1 };
+    for (;;) {
+        dfs_frame_t& frame = dfs_stack_.back();
 
-        // Check boundaries of grid
-        int row = node_row + delta[move][0];
-        int column = node_column + delta[move][1];
-        if (column < 0 || column >= columns_count_ || row < 0 || row >= rows_count_)
-            continue;
+        // For each children
+        if (frame.move < 4) {
+            int cell = frame.cell + delta[frame.move++];
+
+            // Check if it's not blocked way, border included,
+            // and if node already have a parrent
+            if (isBlocked(cell) || visited(cell))
+                continue;
 
-        // Check if it's not blocked way
-        // and if node already have a parrent
-        if (isBlocked(row, column) || visited_[row][column])
+            markVisited(cell);
+            dfs_frame_t child = { cell, 0, 1, 0, 0 };
+            dfs_stack_.push_back(child);
             continue;
+        }
 
-        int depth = dfsVisit(row, column, 1);
+        // All children done, return depth to parent
+        depth = frame.max_depth1 + frame.x;
+        dfs_stack_.pop_back();
+        if (dfs_stack_.empty())
+            break;
 
-        if (depth > max_depth1) {
-            max_depth2 = max_depth1;
-            max_depth1 = depth;
-        } else if (depth > max_depth2) {
-            max_depth2 = depth;
+        dfs_frame_t& parent = dfs_stack_.back();
+        if (depth > parent.max_depth1) {
+            parent.max_depth2 = parent.max_depth1;
+            parent.max_depth1 = depth;
+        } else if (depth > parent.max_depth2) {
+            parent.max_depth2 = depth;
         }
-        rope = max(rope, max_depth1 + max_depth2);
+        rope = max(rope, parent.max_depth1 + parent.max_depth2);
     }
 
-    return max_depth1 + x;
+    return depth;
 }
 
 
-bool Algorithm::isBlocked(int row, int column) {
-    return grid_[row][column] == BLOCKED;
+/**
+ * BFS from given node, level by level, finds last cell of last level
+ * and its distance from node. Cells still to visit hold unvisited mark
+ * in grid_, visit changes it to visited mark, so no separate visited
+ * state has to be cleared between sweeps. Queue is ring buffer of cell
+ * indices, head and tail count pushed and popped cells. With record
+ * visit order and levels are kept in order_ and level_start_.
+ */
+Algorithm::sweep_t Algorithm::bfsSweep(int node, char unvisited, char visited, bool record) {
+    if (queue_.empty())
+        queue_.resize(QUEUE_SIZE);
+    if (record) {
+        order_.clear();
+        level_start_.clear();
+    }
+
+    std::size_t mask = queue_.size() - 1;
+    std::size_t head = 0;
+    std::size_t tail = 0;
+    queue_[tail++] = node;
+    grid_[node] = visited;
+
+    sweep_t sweep = { node, -1, 0, 0 };
+    const int delta[] = { -pitch_, pitch_, -1, 1 };
+    while (head != tail) {
+        std::size_t level_end = tail;
+        if (record)
+            level_start_.push_back(order_.size());
+        while (head != level_end) {
+            int cell = queue_[head++ & mask];
+            sweep.farthest = cell;
+            ++sweep.cells;
+            if (record)
+                order_.push_back(cell);
+            for (int move = 0; move < 4; ++move) {
+                int next = cell + delta[move];
+                if (grid_[next] == BLOCKED)
+                    continue;
+                ++sweep.degrees;
+                if (grid_[next] != unvisited)
+                    continue;
+                grid_[next] = visited;
+
+                // Unroll full ring into twice as large one
+                if (tail - head == queue_.size()) {
+                    vector<int> larger(2 * queue_.size());
+                    for (std::size_t i = head; i != tail; ++i)
+                        larger[i - head] = queue_[i & mask];
+                    queue_.swap(larger);
+                    mask = queue_.size() - 1;
+                    tail -= head;
+                    level_end -= head;
+                    head = 0;
+                }
+                queue_[tail++ & mask] = next;
+            }
+        }
+        ++sweep.distance;
+    }
+    if (record)
+        level_start_.push_back(order_.size());
+
+    return sweep;
 }
 
 /**
- * Runs the algorithm - based on BFS
+ * Longest path of component from double sweep, or in exact mode from
+ * exactDiameter when first sweep finds more edges than tree has
  */
-void Algorithm::run() {
+int Algorithm::measureComponent(int first, int* cycles) {
+    sweep_t first_sweep = bfsSweep(first, FREE, FIRST_SWEEP, false);
+    sweep_t second_sweep = bfsSweep(first_sweep.farthest, FIRST_SWEEP, SECOND_SWEEP, false);
+    *cycles = (int)(first_sweep.degrees / 2 - first_sweep.cells + 1);
+    if (!exact_mode_ || *cycles == 0)
+        return second_sweep.distance;
+    return exactDiameter(second_sweep.farthest, second_sweep.distance);
+}
 
-    for (int row = 0; row < rows_count_; ++row)
-        for (int column = 0; column < columns_count_; ++column)
-            if (grid_[row][column] == BLOCKED)
-                visited_[row][column] = true;
-            else
-                visited_[row][column] = false;
-
-    // Find not blocked node
-    short start_row;
-    short start_column;
-    for (int row = 0; row < rows_count_; ++row) {
-        for (int column = 0; column < columns_count_; ++column) {
-            if (grid_[row][column] == FREE) {
-                start_row = row;
-                start_column = column;
-                goto start_node_found;
+/**
+ * BFS over component swept before, marks of its cells alternate between
+ * FIRST_SWEEP and SECOND_SWEEP, so no clearing is needed between runs
+ */
+Algorithm::sweep_t Algorithm::bfsAgain(int node, bool record) {
+    char visited = sweep_mark_ == FIRST_SWEEP ? SECOND_SWEEP : FIRST_SWEEP;
+    sweep_t sweep = bfsSweep(node, sweep_mark_, visited, record);
+    sweep_mark_ = visited;
+    return sweep;
+}
+
+/**
+ * Exact diameter of component with cycles from bounds of cell
+ * eccentricities: BFS from cell v of eccentricity e gives every cell w
+ * at distance d bounds max(d, e - d) <= ecc(w) <= e + d. Cells whose
+ * bounds can raise neither lower nor lower upper bound of diameter are
+ * dropped, BFS runs alternately from candidate of largest upper and of
+ * smallest lower bound, until diameter bounds meet. It starts from end
+ * of sweep path of given length.
+ */
+int Algorithm::exactDiameter(int end, int length) {
+    sweep_mark_ = SECOND_SWEEP;
+    int lower = length;
+    int upper = 2 * length;
+    ecc_lower_.resize(grid_.size());
+    ecc_upper_.resize(grid_.size());
+    bool by_upper = true;
+    int node = end;
+    for (bool first = true; lower < upper; first = false) {
+        sweep_t sweep = bfsAgain(node, true);
+        if (first) {
+            candidates_ = order_;
+            for (std::size_t i = 0; i < order_.size(); ++i) {
+                ecc_lower_[order_[i]] = 0;
+                ecc_upper_[order_[i]] = std::numeric_limits<int>::max();
             }
         }
+        int ecc = sweep.distance;
+        lower = max(lower, ecc);
+        upper = min(upper, 2 * ecc);
+        for (int level = 0; level <= ecc; ++level) {
+            int reach = max(level, ecc - level);
+            for (int i = level_start_[level]; i < level_start_[level+1]; ++i) {
+                int cell = order_[i];
+                ecc_lower_[cell] = max(ecc_lower_[cell], reach);
+                ecc_upper_[cell] = min(ecc_upper_[cell], ecc + level);
+            }
+        }
+
+        // Drop cells which can not move bounds, pick next BFS source
+        int highest = 0;
+        std::size_t kept = 0;
+        node = -1;
+        for (std::size_t i = 0; i < candidates_.size(); ++i) {
+            int cell = candidates_[i];
+            lower = max(lower, ecc_lower_[cell]);
+            highest = max(highest, ecc_upper_[cell]);
+            if (ecc_lower_[cell] == ecc_upper_[cell]
+                    || (ecc_upper_[cell] <= lower && 2 * ecc_lower_[cell] >= upper))
+                continue;
+            candidates_[kept++] = cell;
+            if (node < 0 || (by_upper ? ecc_upper_[cell] > ecc_upper_[node]
+                                      : ecc_lower_[cell] < ecc_lower_[node]))
+                node = cell;
+        }
+        candidates_.resize(kept);
+        upper = min(upper, max(highest, lower));
+        if (node < 0)
+            break;
+        by_upper = !by_upper;
     }
+    return lower;
+}
+
+/**
+ * Unites free cells of rows [first_row, last_row) with their left and
+ * upper neighbours inside of band, so bands can be labeled in parallel
+ */
+void Algorithm::labelBand(int first_row, int last_row) {
+    for (int row = first_row; row < last_row; ++row) {
+        int cell = row * pitch_ + 1;
+        for (int column = 0; column < columns_count_; ++column, ++cell) {
+            if (grid_[cell] != FREE)
+                continue;
+            parent_[cell] = cell;
+            if (grid_[cell - 1] == FREE)
+                unite(cell, cell - 1);
+            if (row > first_row && grid_[cell - pitch_] == FREE)
+                unite(cell, cell - pitch_);
+        }
+    }
+}
 
-start_node_found:
+/**
+ * Labels components of free cells: bands of rows on threads_count_
+ * threads, then union of cells across band borders, then numbering
+ * of roots in row major order
+ */
+void Algorithm::labelComponents() {
+    parent_.resize(grid_.size());
+    int bands = max(1, min(threads_count_, rows_count_));
+    vector<int> band_start(bands + 1);
+    for (int band = 0; band <= bands; ++band)
+        band_start[band] = 1 + (int)((long long)rows_count_ * band / bands);
+
+    vector<std::thread> workers;
+    for (int band = 1; band < bands; ++band)
+        workers.push_back(std::thread(&Algorithm::labelBand, this, band_start[band], band_start[band+1]));
+    labelBand(band_start[0], band_start[1]);
+    for (std::size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+
+    for (int band = 1; band < bands; ++band) {
+        int cell = band_start[band] * pitch_ + 1;
+        for (int column = 0; column < columns_count_; ++column, ++cell) {
+            if (grid_[cell] == FREE && grid_[cell - pitch_] == FREE)
+                unite(cell, cell - pitch_);
+        }
+    }
+
+    // Point every cell straight to its root
+    for (int row = 1; row <= rows_count_; ++row) {
+        int cell = row * pitch_ + 1;
+        for (int column = 0; column < columns_count_; ++column, ++cell) {
+            if (grid_[cell] == FREE)
+                parent_[cell] = findRoot(cell);
+        }
+    }
+
+    // Root is first cell of component, so it gets its index before
+    // any other cell of component needs it
+    components_.clear();
+    for (int row = 1; row <= rows_count_; ++row) {
+        int cell = row * pitch_ + 1;
+        for (int column = 0; column < columns_count_; ++column, ++cell) {
+            if (grid_[cell] != FREE)
+                continue;
+            int root = parent_[cell];
+            if (root == cell) {
+                component_t component = { cell, 0, 0, 0 };
+                parent_[cell] = -1 - (int)components_.size();
+                components_.push_back(component);
+            }
+            ++components_[-1 - parent_[root]].size;
+        }
+    }
+}
+
+/**
+ * Clears visited bits of grid of current case
+ */
+void Algorithm::clearVisited() {
+    std::size_t words = (grid_.size() + 63) / 64;
+    if (visited_.size() < words)
+        visited_.resize(words);
+    std::fill(visited_.begin(), visited_.begin() + words, 0);
+}
+
+bool Algorithm::isBlocked(int cell) {
+    return grid_[cell] == BLOCKED;
+}
+
+/**
+ * Runs the algorithm - based on DFS from first free node, or on two
+ * BFS sweeps: farthest cell from any cell is end of some longest path
+ * of tree, and the farthest cell from it is the other end
+ */
+void Algorithm::run() {
     rope = 0;
-    tree_data_t data;
-    dfsVisit(start_row, start_column, 0);
+    cycles_ = 0;
+    if (start_ < 0) {
+        components_.clear();
+        return;
+    }
+
+    if (components_mode_) {
+        labelComponents();
+        for (std::size_t i = 0; i < components_.size(); ++i) {
+            components_[i].longest = measureComponent(components_[i].first, &components_[i].cycles);
+            rope = max(rope, components_[i].longest);
+            cycles_ += components_[i].cycles;
+        }
+        return;
+    }
+
+    if (engine_ == ENGINE_SWEEP || exact_mode_) {
+        int cycles;
+        rope = measureComponent(start_, &cycles);
+        cycles_ = cycles;
+        return;
+    }
+
+    clearVisited();
+    dfsVisit(start_, 0);
 }
 
 
 /**
- * Parse input into Algorithm
+ * Parse input into Algorithm, rows are read straight into padded
+ * grid and first free cell is found on the way
  */
 void Algorithm::readInput() {
-    scanf("%d %d", &columns_count_, &rows_count_);
-    if (columns_count_ > GRID_SIZE || rows_count_ > GRID_SIZE)
-        return;
+    columns_count_ = input.ReadInt();
+    rows_count_ = input.ReadInt();
+    pitch_ = columns_count_ + 2;
+
+    // Extra cell for terminating zero of last row, std::fill takes
+    // value by reference, so it gets local copy of class constant
+    const char blocked = BLOCKED;
+    grid_.resize((std::size_t)(rows_count_ + 2) * pitch_ + 1);
+    std::fill(grid_.begin(), grid_.begin() + pitch_, blocked);
+    std::fill(grid_.end() - pitch_ - 1, grid_.end(), blocked);
+
+    start_ = -1;
     for (int line = 0; line < rows_count_; ++line) {
-        scanf("%s", grid_[line]);
-        // for (int column = 0; column < columns_count_; ++column)
-            // parent_[line][column] = node_t(-1, -1);
+        char* row = &grid_[(std::size_t)(line + 1) * pitch_];
+        input.ReadWord(row + 1);
+        row[0] = BLOCKED;
+        row[pitch_ - 1] = BLOCKED;
+        if (start_ < 0) {
+            const char* free = static_cast<const char*>(std::memchr(row + 1, FREE, columns_count_));
+            if (free != NULL)
+                start_ = free - &grid_[0];
+        }
     }
 }
 
 /**
  * Prints the output
  */
-void Algorithm::printOutput() {
+void Algorithm::printOutput(OutputWriter& out) {
     // for (int line = 0; line < rows_count_; ++line) {
     //     printf("%s\n", grid_[line]);
     // }
     // Print tree span
     //printf("Maximum rope length is %d.\n", tree_span(tree_info_));
-    std::cout << "Maximum rope length is " << rope << "." << std::endl;
+    out.WriteString("Maximum rope length is ");
+    out.WriteInt(rope);
+    out.WriteString(".\n");
+
+    // Which metric was used, double sweep of trees or exact diameter
+    if (exact_mode_) {
+        if (cycles_ == 0) {
+            out.WriteString("Mode: tree\n");
+        } else {
+            out.WriteString("Mode: exact diameter, cycles ");
+            out.WriteInt(cycles_);
+            out.WriteChar('\n');
+        }
+    }
+    if (!components_mode_)
+        return;
+
+    // Count of components, then size and longest path of each, and
+    // cycles of each in exact mode
+    out.WriteString("Components: ");
+    out.WriteInt(components_.size());
+    out.WriteChar('\n');
+    for (std::size_t i = 0; i < components_.size(); ++i) {
+        out.WriteInt(components_[i].size);
+        out.WriteChar(' ');
+        out.WriteInt(components_[i].longest);
+        if (exact_mode_) {
+            out.WriteChar(' ');
+            out.WriteInt(components_[i].cycles);
+        }
+        out.WriteChar('\n');
+    }
 }
 
 /**
@@ -145,24 +793,302 @@ void Algorithm::printOutput() {
 void run_testcase() {
     algo.readInput();
     algo.run();
-    algo.printOutput();
+    algo.printOutput(output);
 }
 
 /**
  * Main loop
  */
 void run_tests_loop() {
-    int test_number = 0;
-    scanf("%d", &test_number);
+    int test_number = input.ReadInt();
     while (test_number--) {
         run_testcase();
     }
 }
 
 /**
- * Main entry point
+ * Solves every step-th case of batch starting from first,
+ * each into its own output
+ */
+void solve_cases(vector<Algorithm*>* cases, vector<std::string>* outputs, int count, int first, int step) {
+    for (int i = first; i < count; i += step) {
+        OutputWriter writer(&(*outputs)[i]);
+        (*cases)[i]->run();
+        (*cases)[i]->printOutput(writer);
+        writer.Flush();
+    }
+}
+
+/**
+ * Runs test cases in batches on workers_count threads, each worker with
+ * its own Algorithm states. Cases of batch are parsed in input order,
+ * solved in parallel, and printed in input order.
+ */
+void run_tests_batch(int workers_count) {
+    const int CASES_PER_WORKER = 4;
+    const int batch_size = workers_count * CASES_PER_WORKER;
+    vector<Algorithm*> cases(batch_size);
+    vector<std::string> outputs(batch_size);
+    for (int i = 0; i < batch_size; ++i)
+        cases[i] = new Algorithm(algo);
+
+    int test_number = input.ReadInt();
+    while (test_number > 0) {
+        int count = std::min(test_number, batch_size);
+        test_number -= count;
+        for (int i = 0; i < count; ++i)
+            cases[i]->readInput();
+
+        vector<std::thread> workers;
+        for (int worker = 0; worker < workers_count; ++worker)
+            workers.push_back(std::thread(solve_cases, &cases, &outputs, count, worker, workers_count));
+        for (int worker = 0; worker < workers_count; ++worker)
+            workers[worker].join();
+
+        for (int i = 0; i < count; ++i) {
+            output.Write(outputs[i]);
+            outputs[i].clear();
+        }
+    }
+
+    for (int i = 0; i < batch_size; ++i)
+        delete cases[i];
+}
+
+/**
+ * Bounded lock-free queue of single producer and single consumer.
+ * Push and Pop spin a while when queue is full or empty, then sleep on
+ * condition variable until other side moves, so stage waiting for I/O
+ * does not keep its core busy. Other side takes the mutex only when
+ * somebody sleeps.
  */
-int main() {
-    run_tests_loop();
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity) : items_(capacity+1), head_(0), tail_(0), sleepers_(0) { }
+
+    bool TryPush(const T& item) {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        std::size_t next = (tail+1 == items_.size()) ? 0 : tail+1;
+        if (next == head_.load(std::memory_order_acquire))
+            return false;
+        items_[tail] = item;
+        tail_.store(next);
+        Wake();
+        return true;
+    }
+
+    bool TryPop(T& item) {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = items_[head];
+        head_.store((head+1 == items_.size()) ? 0 : head+1);
+        Wake();
+        return true;
+    }
+
+    void Push(const T& item) {
+        for (int spin = 0; !TryPush(item); ++spin) {
+            if (spin < SPIN_COUNT)
+                std::this_thread::yield();
+            else
+                Sleep(&SpscQueue::Full);
+        }
+    }
+
+    T Pop() {
+        T item;
+        for (int spin = 0; !TryPop(item); ++spin) {
+            if (spin < SPIN_COUNT)
+                std::this_thread::yield();
+            else
+                Sleep(&SpscQueue::Empty);
+        }
+        return item;
+    }
+
+private:
+    static const int SPIN_COUNT = 64;
+
+    bool Full() const {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        return ((tail+1 == items_.size()) ? 0 : tail+1) == head_.load();
+    }
+
+    bool Empty() const {
+        return head_.load(std::memory_order_relaxed) == tail_.load();
+    }
+
+    // Sleeper is counted before it checks the queue again, and the other
+    // side stores its index before it reads the count (both sequentially
+    // consistent), so either sleeper sees the change or it gets woken
+    void Sleep(bool (SpscQueue::*blocked)() const) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        while ((this->*blocked)())
+            wakeup_.wait(lock);
+        sleepers_.fetch_sub(1);
+    }
+
+    void Wake() {
+        if (sleepers_.load() == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        wakeup_.notify_all();
+    }
+
+// Data
+private:
+    std::vector<T> items_;
+    std::atomic<std::size_t> head_;
+    std::atomic<std::size_t> tail_;
+    std::atomic<int> sleepers_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+};
+
+/**
+ * Streaming runner of test cases: this thread parses cases, workers solve
+ * them and writer thread prints them in input order, all at the same time.
+ * Case i goes to worker i % workers_count, so every queue has single
+ * producer and single consumer. Cases live in fixed number of slots
+ * returned by writer to parser, so memory stays bounded for any input.
+ * Case type provides Read() and Solve(OutputWriter&).
+ */
+template <typename Case>
+class Pipeline {
+public:
+    explicit Pipeline(int workers_count)
+        : workers_count_(workers_count), slots_count_(workers_count * SLOTS_PER_WORKER),
+          free_slots_(slots_count_) {
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            to_solve_.push_back(new SpscQueue<Slot*>(slots_count_));
+            to_write_.push_back(new SpscQueue<Slot*>(slots_count_));
+        }
+        for (int i = 0; i < slots_count_; ++i) {
+            slots_.push_back(new Slot());
+            free_slots_.Push(slots_.back());
+        }
+    }
+
+    ~Pipeline() {
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            delete to_solve_[worker];
+            delete to_write_[worker];
+        }
+        for (int i = 0; i < slots_count_; ++i)
+            delete slots_[i];
+    }
+
+    void Run(int test_number) {
+        std::vector<std::thread> threads;
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            int cases_count = (test_number - worker + workers_count_ - 1) / workers_count_;
+            threads.push_back(std::thread(&Pipeline::Solve, this, worker, cases_count));
+        }
+        threads.push_back(std::thread(&Pipeline::Write, this, test_number));
+
+        for (int i = 0; i < test_number; ++i) {
+            Slot* slot = free_slots_.Pop();
+            slot->item.Read();
+            to_solve_[i % workers_count_]->Push(slot);
+        }
+
+        for (std::size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+    }
+
+private:
+    static const int SLOTS_PER_WORKER = 4;
+
+    struct Slot {
+        Case item;
+        std::string output;
+    };
+
+    void Solve(int worker, int cases_count) {
+        while (cases_count--) {
+            Slot* slot = to_solve_[worker]->Pop();
+            {
+                OutputWriter writer(&slot->output);
+                slot->item.Solve(writer);
+            }
+            to_write_[worker]->Push(slot);
+        }
+    }
+
+    void Write(int test_number) {
+        for (int i = 0; i < test_number; ++i) {
+            Slot* slot = to_write_[i % workers_count_]->Pop();
+            output.Write(slot->output);
+            slot->output.clear();
+            free_slots_.Push(slot);
+        }
+    }
+
+// Data
+private:
+    int workers_count_;
+    int slots_count_;
+    std::vector<Slot*> slots_;
+    SpscQueue<Slot*> free_slots_;
+    std::vector<SpscQueue<Slot*>*> to_solve_;
+    std::vector<SpscQueue<Slot*>*> to_write_;
+};
+
+/**
+ * Test case of pipeline mode, own copy of Algorithm state
+ */
+struct PipelineCase {
+    Algorithm algo;
+    PipelineCase() : algo(::algo) { }
+    void Read() {
+        algo.readInput();
+    }
+    void Solve(OutputWriter& out) {
+        algo.run();
+        algo.printOutput(out);
+    }
+};
+
+/**
+ * Main entry point, "-j N" solves test cases on N threads,
+ * "-p N" streams them through pipeline with N solving threads,
+ * "sweep" computes rope length with double sweep BFS, "components"
+ * reports size and longest path of every component of free cells,
+ * labeled on N threads when number N is given, "exact" measures
+ * components with cycles by exact diameter and reports cycles
+ */
+int main(int argc, char* argv[]) {
+    int workers_count = 1;
+    int pipeline_workers = 0;
+    bool components_mode = false;
+    int threads_count = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "sweep")
+            algo.setEngine(Algorithm::ENGINE_SWEEP);
+        else if (arg == "components")
+            components_mode = true;
+        else if (arg == "exact")
+            algo.setExactMode(true);
+        else if (std::atoi(arg.c_str()) > 0)
+            threads_count = std::atoi(arg.c_str());
+        else if (arg == "-j" && i+1 < argc)
+            workers_count = std::atoi(argv[++i]);
+        else if (arg == "-p" && i+1 < argc)
+            pipeline_workers = std::atoi(argv[++i]);
+    }
+    algo.setComponentsMode(components_mode, threads_count);
+
+    if (pipeline_workers > 0) {
+        Pipeline<PipelineCase> pipeline(pipeline_workers);
+        pipeline.Run(input.ReadInt());
+    } else if (workers_count > 1) {
+        run_tests_batch(workers_count);
+    } else {
+        run_tests_loop();
+    }
     return 0;
 }
\ No newline at end of file
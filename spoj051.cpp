@@ -6,10 +6,220 @@
 #include <algorithm>
 #include <stdexcept>
 #include <iterator>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define for_outedge(e, coll) \
     for (typename Graph::OutgoingEdgeList::iterator e = coll.begin(); edge_iterator != coll.end(); ++e)
 
+/**
+ * Bulk reader of stdin. Regular file is mapped into memory at once,
+ * pipe is read in large blocks. Numbers and words are parsed straight
+ * from the buffer, no library call per token.
+ */
+class InputReader {
+public:
+    InputReader() : pos_(NULL), end_(NULL), mapped_(NULL), mapped_size_(0) {
+        struct stat info;
+        off_t offset = lseek(0, 0, SEEK_CUR);
+        if (fstat(0, &info) == 0 && S_ISREG(info.st_mode) && offset >= 0 && info.st_size > offset) {
+            void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, 0, 0);
+            if (data != MAP_FAILED) {
+                mapped_ = static_cast<char*>(data);
+                mapped_size_ = info.st_size;
+                pos_ = mapped_ + offset;
+                end_ = mapped_ + mapped_size_;
+            }
+        }
+    }
+
+    ~InputReader() {
+        if (mapped_ != NULL)
+            munmap(mapped_, mapped_size_);
+    }
+
+    /**
+     * Reads signed decimal number, like scanf("%d")
+     */
+    int ReadInt() {
+        SkipSpaces();
+        bool negative = false;
+        if (Peek() == '-' || Peek() == '+') {
+            negative = (*pos_ == '-');
+            ++pos_;
+        }
+        int value = 0;
+        for (int c = Peek(); c >= '0' && c <= '9'; c = Peek()) {
+            value = value * 10 + (c - '0');
+            ++pos_;
+        }
+        return negative ? -value : value;
+    }
+
+    /**
+     * Reads word into buffer, like scanf("%s"), returns its length
+     */
+    std::size_t ReadWord(char* word) {
+        SkipSpaces();
+        std::size_t length = 0;
+        for (int c = Peek(); c != EOF && c > ' '; c = Peek()) {
+            // Copy whole run of non space characters available in buffer
+            const char* run = pos_;
+            while (run != end_ && static_cast<unsigned char>(*run) > ' ')
+                ++run;
+            std::memcpy(word + length, pos_, run - pos_);
+            length += run - pos_;
+            pos_ = run;
+        }
+        word[length] = '\0';
+        return length;
+    }
+
+private:
+    static const std::size_t BLOCK_SIZE = 1 << 16;
+
+    inline int Peek() {
+        if (pos_ == end_ && !Refill())
+            return EOF;
+        return static_cast<unsigned char>(*pos_);
+    }
+
+    inline void SkipSpaces() {
+        for (int c = Peek(); c != EOF && c <= ' '; c = Peek())
+            ++pos_;
+    }
+
+    bool Refill() {
+        if (mapped_ != NULL)
+            return false;
+        ssize_t count = read(0, block_, BLOCK_SIZE);
+        if (count <= 0)
+            return false;
+        pos_ = block_;
+        end_ = block_ + count;
+        return true;
+    }
+
+// Data
+private:
+    const char* pos_;
+    const char* end_;
+    char* mapped_;
+    std::size_t mapped_size_;
+    char block_[BLOCK_SIZE];
+} input;
+
+/**
+ * Bulk writer to stdout. Output is formatted into large buffer and
+ * written out only when buffer fills up and at exit. Small numbers
+ * are copied from precomputed table of their digits. Writer given
+ * a string collects output there instead, to be written later.
+ */
+class OutputWriter {
+public:
+    explicit OutputWriter(std::string* capture = NULL) : pos_(buffer_), capture_(capture) {
+        for (int value = 0; value < SMALL_INTS; ++value) {
+            int length = 0;
+            for (int rest = value; rest > 0 || length == 0; rest /= 10)
+                ++length;
+            small_lengths_[value] = length;
+            for (int i = length-1, rest = value; i >= 0; --i, rest /= 10)
+                small_digits_[value][i] = '0' + rest % 10;
+        }
+    }
+
+    ~OutputWriter() {
+        Flush();
+    }
+
+    inline void WriteInt(int value) {
+        if (pos_ + MAX_INT_LENGTH > buffer_ + BUFFER_SIZE)
+            Flush();
+        if (value >= 0 && value < SMALL_INTS) {
+            std::memcpy(pos_, small_digits_[value], SMALL_DIGITS);
+            pos_ += small_lengths_[value];
+            return;
+        }
+        unsigned int rest = value;
+        if (value < 0) {
+            *pos_++ = '-';
+            rest = -rest;
+        }
+        char digits[MAX_INT_LENGTH];
+        int length = 0;
+        do {
+            digits[length++] = '0' + rest % 10;
+            rest /= 10;
+        } while (rest > 0);
+        while (length > 0)
+            *pos_++ = digits[--length];
+    }
+
+    inline void WriteChar(char c) {
+        if (pos_ == buffer_ + BUFFER_SIZE)
+            Flush();
+        *pos_++ = c;
+    }
+
+    void WriteString(const char* text) {
+        for (; *text != '\0'; ++text)
+            WriteChar(*text);
+    }
+
+    void Write(const std::string& text) {
+        if (pos_ + text.size() > buffer_ + BUFFER_SIZE)
+            Flush();
+        if (text.size() > (std::size_t)BUFFER_SIZE) {
+            WriteOut(text.data(), text.data() + text.size());
+            return;
+        }
+        std::memcpy(pos_, text.data(), text.size());
+        pos_ += text.size();
+    }
+
+    void Flush() {
+        WriteOut(buffer_, pos_);
+        pos_ = buffer_;
+    }
+
+private:
+    void WriteOut(const char* data, const char* end) {
+        if (capture_ != NULL) {
+            capture_->append(data, end);
+            return;
+        }
+        while (data < end) {
+            ssize_t count = write(1, data, end - data);
+            if (count <= 0)
+                break;
+            data += count;
+        }
+    }
+
+    static const int BUFFER_SIZE = 1 << 16;
+    static const int MAX_INT_LENGTH = 12;
+    static const int SMALL_INTS = 1000;
+    static const int SMALL_DIGITS = 4;
+
+// Data
+private:
+    char* pos_;
+    std::string* capture_;
+    char buffer_[BUFFER_SIZE];
+    char small_digits_[SMALL_INTS][SMALL_DIGITS];
+    char small_lengths_[SMALL_INTS];
+} output;
+
 /**
  * OutEdge
  */
@@ -64,27 +274,145 @@ public:
         return vertex_edges_.size();
     }
 
-    template<typename Graph>
-    friend void Transpose(Graph& oryginal, Graph& transposed);
+    // Nothing to pack, lists are ready to read
+    inline void Pack() { }
 
 // Data
 private:
     VertexOutgoingEdges vertex_edges_;
 };
 
+/**
+ * Compressed sparse row representation of graph.
+ * Graph is built in bulk from edge buffer by Build, or edges are collected
+ * by CreateEdge and packed by Pack, into contiguous offset + target arrays,
+ * so walking out-edges is a linear scan instead of a list pointer chase.
+ * EdgeListOf reads packed arrays only.
+ */
+class CsrAdjacencyList {
+public:
+    typedef ::OutEdge OutEdge;
+    typedef ::Edge Edge;
+    typedef std::vector<Edge> EdgeBuffer;
+
+    /**
+     * View of a single vertex out-edges inside the packed target array
+     */
+    class OutgoingEdgeList {
+    public:
+        typedef OutEdge* iterator;
+        OutgoingEdgeList(OutEdge* first, OutEdge* last) : first_(first), last_(last) { }
+        inline iterator begin() const { return first_; }
+        inline iterator end() const { return last_; }
+        inline std::size_t size() const { return last_ - first_; }
+    private:
+        OutEdge* first_;
+        OutEdge* last_;
+    };
+
+    CsrAdjacencyList() : vertices_count_(0), packed_(false) { }
+
+    inline std::size_t CreateVertices(std::size_t u) {
+        if (packed_)
+            Unpack();
+        vertices_count_ = u;
+        return vertices_count_;
+    }
+
+    inline std::size_t PushVertex() {
+        if (packed_)
+            Unpack();
+        return vertices_count_++;
+    }
+
+    inline void CreateEdge(std::size_t u, std::size_t v) {
+        if (packed_)
+            Unpack();
+        vertices_count_ = std::max(vertices_count_, std::max(u, v)+1);
+        OutEdge e = {v};
+        pending_edges_.push_back(Edge(e, u));
+    }
+
+    /**
+     * Replace graph with vertices_count vertices and edges from buffer
+     */
+    void Build(std::size_t vertices_count, EdgeBuffer& edges) {
+        vertices_count_ = vertices_count;
+        pending_edges_.swap(edges);
+        edges.clear();
+        Pack();
+    }
+
+    inline OutgoingEdgeList EdgeListOf(std::size_t u) {
+        if (u >= vertices_count_)
+            throw std::out_of_range("CsrAdjacencyList::EdgeListOf");
+        OutEdge* targets = targets_.empty() ? NULL : &targets_[0];
+        return OutgoingEdgeList(targets + offsets_[u], targets + offsets_[u+1]);
+    }
+
+    inline std::size_t VerticesCount() {
+        return vertices_count_;
+    }
+
+    /**
+     * Counting sort of pending edges by source, keeps insertion order per vertex.
+     * Packed graph is safe to read from many threads.
+     */
+    void Pack() {
+        if (packed_)
+            return;
+
+        // Edges of vertices dropped by CreateVertices are discarded
+        offsets_.assign(vertices_count_+1, 0);
+        for (std::size_t i = 0; i < pending_edges_.size(); ++i)
+            if (pending_edges_[i].src < vertices_count_)
+                ++offsets_[pending_edges_[i].src+1];
+        for (std::size_t u = 0; u < vertices_count_; ++u)
+            offsets_[u+1] += offsets_[u];
+
+        std::vector<std::size_t> cursor(offsets_.begin(), offsets_.end()-1);
+        targets_.resize(offsets_.back());
+        for (std::size_t i = 0; i < pending_edges_.size(); ++i)
+            if (pending_edges_[i].src < vertices_count_)
+                targets_[cursor[pending_edges_[i].src]++] = pending_edges_[i];
+
+        EdgeBuffer().swap(pending_edges_);
+        packed_ = true;
+    }
+
+private:
+    // Move packed edges back to buffer, so more edges can be appended
+    void Unpack() {
+        pending_edges_.reserve(targets_.size());
+        for (std::size_t u = 0; u+1 < offsets_.size(); ++u)
+            for (std::size_t i = offsets_[u]; i < offsets_[u+1]; ++i)
+                pending_edges_.push_back(Edge(targets_[i], u));
+        std::vector<std::size_t>().swap(offsets_);
+        std::vector<OutEdge>().swap(targets_);
+        packed_ = false;
+    }
+
+// Data
+private:
+    std::size_t vertices_count_;
+    bool packed_;
+    std::vector<std::size_t> offsets_;
+    std::vector<OutEdge> targets_;
+    EdgeBuffer pending_edges_;
+};
+
 /**
  * Transpose a graph
  */
 template<typename Graph>
 void Transpose(Graph& oryginal, Graph& transposed) {
-    transposed.vertex_edges_.resize(oryginal.vertex_edges_.size());
-    for (std::size_t vertex_index = 0; vertex_index < oryginal.vertex_edges_.size(); ++vertex_index) {
+    transposed.CreateVertices(oryginal.VerticesCount());
+    for (std::size_t vertex_index = 0; vertex_index < oryginal.VerticesCount(); ++vertex_index) {
         for_outedge(edge_iterator, oryginal.EdgeListOf(vertex_index)) {
-            typename Graph::OutEdge transposed_edge = *edge_iterator;
-            transposed_edge.dst = vertex_index;
-            transposed.EdgeListOf(edge_iterator->dst).push_back(transposed_edge);
+            transposed.CreateEdge(edge_iterator->dst, vertex_index);
         }
     }
+    transposed.Pack();
 }
 
 namespace impl {
@@ -108,30 +436,65 @@ struct DfsVisitorBase {
 };
 
 /**
- * Dfs Visit function
+ * Dfs stack frame: vertex and its next out-edge to examine
+ */
+template <typename Graph>
+struct DfsFrame {
+    typedef typename Graph::OutgoingEdgeList::iterator EdgeIterator;
+    DfsFrame(Graph& graph, std::size_t u)
+        : vertex(u), edge(graph.EdgeListOf(u).begin()), end(graph.EdgeListOf(u).end()) { }
+    std::size_t vertex;
+    EdgeIterator edge;
+    EdgeIterator end;
+};
+
+/**
+ * Dfs Visit function, iterative with explicit frame stack.
+ * Fires visitor callbacks in the same order as recursive visit would.
  */
 template <typename Graph, typename Visitor, typename ColorMap>
-void DfsVisit(Graph& graph, Visitor& visitor, ColorMap& colors, std::size_t u_index) {
+void DfsVisit(Graph& graph, Visitor& visitor, ColorMap& colors, std::size_t u_index,
+              std::vector<DfsFrame<Graph> >& stack) {
+    stack.clear();
     visitor.OnVertexStart(graph, u_index);
     colors.at(u_index) = impl::GRAY;
+    stack.push_back(DfsFrame<Graph>(graph, u_index));
 
-    for_outedge(edge_iterator, graph.EdgeListOf(u_index)) {
-        typename Graph::Edge edge(*edge_iterator, u_index);
-        if (colors.at(edge_iterator->dst) == impl::WHITE) {
+    while (!stack.empty()) {
+        DfsFrame<Graph>& frame = stack.back();
+
+        // All out-edges done, finish vertex and return to parent
+        if (frame.edge == frame.end) {
+            colors.at(frame.vertex) = impl::BLACK;
+            visitor.OnVertexFinish(graph, frame.vertex);
+            stack.pop_back();
+            continue;
+        }
+
+        typename Graph::Edge edge(*frame.edge, frame.vertex);
+        ++frame.edge;
+        if (colors.at(edge.dst) == impl::WHITE) {
             visitor.OnTreeEdge(graph, edge);
-            DfsVisit(graph, visitor, colors, edge_iterator->dst);
+            visitor.OnVertexStart(graph, edge.dst);
+            colors.at(edge.dst) = impl::GRAY;
+            stack.push_back(DfsFrame<Graph>(graph, edge.dst));
         }
-        else if (colors.at(edge_iterator->dst) == impl::GRAY) {
+        else if (colors.at(edge.dst) == impl::GRAY) {
             visitor.OnBackEdge(graph, edge);
         }
         else {
             visitor.OnCrossOrForwardEdge(graph, edge);
         }
-
     }
+}
 
-    colors.at(u_index) = impl::BLACK;
-    visitor.OnVertexFinish(graph, u_index);
+/**
+ * Dfs Visit function
+ */
+template <typename Graph, typename Visitor, typename ColorMap>
+void DfsVisit(Graph& graph, Visitor& visitor, ColorMap& colors, std::size_t u_index) {
+    std::vector<DfsFrame<Graph> > stack;
+    DfsVisit(graph, visitor, colors, u_index, stack);
 }
 
 /**
@@ -140,10 +503,12 @@ void DfsVisit(Graph& graph, Visitor& visitor, ColorMap& colors, std::size_t u_in
 template <typename Graph, typename Visitor>
 void DeepFirstSearch(Graph& graph, Visitor& visitor) {
     std::vector<int> colors(graph.VerticesCount(), impl::WHITE);
+    std::vector<DfsFrame<Graph> > stack;
+    stack.reserve(graph.VerticesCount());
     for (std::size_t vertex_index = 0; vertex_index < graph.VerticesCount(); ++vertex_index)
         if (colors.at(vertex_index) == impl::WHITE) {
             visitor.OnTreeStart(graph, vertex_index);
-            DfsVisit(graph, visitor, colors, vertex_index);
+            DfsVisit(graph, visitor, colors, vertex_index, stack);
             visitor.OnTreeFinish(graph, vertex_index);
         }
 }
@@ -157,11 +522,13 @@ void DeepFirstSearch(Graph& graph, Visitor& visitor, std::vector<std::size_t> ve
         throw std::range_error("vertices_order size does not mach vertex count");
 
     std::vector<int> colors(graph.VerticesCount(), impl::WHITE);
+    std::vector<DfsFrame<Graph> > stack;
+    stack.reserve(graph.VerticesCount());
 
     for (std::size_t index = 0; index < vertices_order.size(); ++index) {
         if (colors.at(vertices_order.at(index)) == impl::WHITE) {
             visitor.OnTreeStart(graph, vertices_order.at(index));
-            DfsVisit(graph, visitor, colors, vertices_order.at(index));
+            DfsVisit(graph, visitor, colors, vertices_order.at(index), stack);
             visitor.OnTreeFinish(graph, vertices_order.at(index));
         }
     }
@@ -176,15 +543,19 @@ struct VertexFinishOrderVisitor : public DfsVisitorBase<Graph> {
     std::vector<std::size_t> visit_order;
 };
 
+/**
+ * Second pass visitor of two-pass Kosaraju SCC: every DFS tree over
+ * transposed graph in reverse finish order is one component, numbered
+ * in order of trees. Reference engine, selected by "kosaraju" argument.
+ */
 template <typename Graph>
 struct SccVisitor : public DfsVisitorBase<Graph> {
-    //std::vector<std::vector<std::size_t> > scc;
     std::vector<std::size_t> vertices_roots;
     std::vector<std::size_t> scc_sizes;
     std::size_t current_root;
     std::size_t current_scc_id;
     std::size_t current_scc_count;
-    Graph scc_graph;
+    std::size_t scc_count;
     SccVisitor(Graph& orig) {
         vertices_roots.resize(orig.VerticesCount());
         scc_sizes.resize(orig.VerticesCount());
@@ -193,43 +564,89 @@ struct SccVisitor : public DfsVisitorBase<Graph> {
         current_root = -1;
         current_scc_id = -1;
         current_scc_count = 0;
+        scc_count = 0;
     }
     inline void OnVertexStart(Graph& g, std::size_t u) {
-        //scc.back().push_back(u);
-        //vertices_roots[u] = current_root;
         vertices_roots[u] = current_scc_id;
         ++current_scc_count;
     }
     inline void OnTreeStart(Graph& g, std::size_t root) {
-        //scc.push_back(std::vector<std::size_t>());
         current_root = root;
         current_scc_count = 0;
         ++current_scc_id;
-        //D( current_scc_count );
-
-        //tree_roots.push_back(root);
-        scc_graph.PushVertex();
+        ++scc_count;
     }
     inline void OnTreeFinish(Graph& g, std::size_t root) {
         scc_sizes[vertices_roots.at(root)] = current_scc_count;
-        // D( vertices_roots.at(root) );
-        // D( root );
-        // D( scc_sizes[vertices_roots.at(root)] );
     }
-    inline void OnTreeEdge(Graph& g, typename Graph::Edge& e) { 
+};
+
+
+/**
+ * One pass SCC visitor, Pearce's variant of Tarjan algorithm.
+ * Single rindex array replaces index/lowlink/on-stack of Tarjan: finished
+ * components get rindex above any DFS index, so they never lower it.
+ * Fills the same outputs as SccVisitor, without the transposed graph;
+ * components are numbered in completion (reverse topological) order.
+ */
+template <typename Graph>
+struct PearceSccVisitor : public DfsVisitorBase<Graph> {
+    std::vector<std::size_t> vertices_roots;
+    std::vector<std::size_t> scc_sizes;
+    std::size_t scc_count;
+    PearceSccVisitor(Graph& orig) {
+        vertices_roots.resize(orig.VerticesCount(), -1);
+        scc_sizes.resize(orig.VerticesCount());
+        rindex_.resize(orig.VerticesCount(), -1);
+        root_.resize(orig.VerticesCount());
+        scc_count = 0;
+        next_index_ = 0;
+    }
+    inline void OnVertexStart(Graph& g, std::size_t u) {
+        rindex_[u] = next_index_++;
+        root_[u] = true;
+        path_.push_back(u);
+    }
+    inline void OnBackEdge(Graph& g, typename Graph::Edge& e) {
+        Lower(e.src, e.dst);
     }
     inline void OnCrossOrForwardEdge(Graph& g, typename Graph::Edge& e) {
-        if (vertices_roots.at(e.dst) != vertices_roots.at(e.src))
-            scc_graph.CreateEdge( vertices_roots.at(e.dst), vertices_roots.at(e.src) );
-        // PrintEdge(e); 
-        // D (vertices_roots.at(e.dst) << "," << vertices_roots.at(e.src));
+        Lower(e.src, e.dst);
     }
-    inline void OnBackEdge(Graph& g, typename Graph::Edge& e) { 
-        //PrintEdge(e); 
-
+    inline void OnVertexFinish(Graph& g, std::size_t u) {
+        path_.pop_back();
+        if (!root_[u]) {
+            stack_.push_back(u);
+        } else {
+            // u is root of component, its members are u and stack top
+            std::size_t scc_begin = stack_.size();
+            while (scc_begin > 0 && rindex_[stack_[scc_begin-1]] >= rindex_[u])
+                --scc_begin;
+            stack_.push_back(u);
+            for (std::size_t i = scc_begin; i < stack_.size(); ++i) {
+                rindex_[stack_[i]] = g.VerticesCount() + scc_count;
+                vertices_roots[stack_[i]] = scc_count;
+            }
+            scc_sizes[scc_count] = stack_.size() - scc_begin;
+            stack_.resize(scc_begin);
+            ++scc_count;
+        }
+        // Propagate to parent as tree edge
+        if (!path_.empty())
+            Lower(path_.back(), u);
     }
-    // inline void OnCrossOrForwardEdge(Graph& g, typename Graph::Edge& e) { PrintEdge(e); }
-    inline void PrintEdge(typename Graph::Edge& e) { D( e.src+1 << "->" << e.dst+1 ); }
+private:
+    inline void Lower(std::size_t u, std::size_t v) {
+        if (rindex_[v] < rindex_[u]) {
+            rindex_[u] = rindex_[v];
+            root_[u] = false;
+        }
+    }
+    std::vector<std::size_t> rindex_;
+    std::vector<bool> root_;
+    std::vector<std::size_t> path_;
+    std::vector<std::size_t> stack_;
+    std::size_t next_index_;
 };
 
 
@@ -243,7 +660,40 @@ struct DebugPrinter : public DfsVisitorBase<Graph> {
 };
 
 /**
- * Strongly connected components algorithm
+ * Writes every DFS event as line of text, vertices numbered from 1 as
+ * in input, so traces of two DFS implementations can be compared
+ */
+template <typename Graph>
+struct TraceVisitor : public DfsVisitorBase<Graph> {
+    explicit TraceVisitor(OutputWriter& out) : out_(out) { }
+    inline void OnVertexStart(Graph& g, std::size_t u) { Print("start", u); }
+    inline void OnVertexFinish(Graph& g, std::size_t u) { Print("finish", u); }
+    inline void OnTreeEdge(Graph& g, typename Graph::Edge& e) { Print("tree", e.src, e.dst); }
+    inline void OnBackEdge(Graph& g, typename Graph::Edge& e) { Print("back", e.src, e.dst); }
+    inline void OnCrossOrForwardEdge(Graph& g, typename Graph::Edge& e) { Print("cross", e.src, e.dst); }
+    inline void OnTreeStart(Graph& g, std::size_t root) { Print("root", root); }
+    inline void OnTreeFinish(Graph& g, std::size_t root) { Print("done", root); }
+private:
+    void Print(const char* event, std::size_t u) {
+        out_.WriteString(event);
+        out_.WriteChar(' ');
+        out_.WriteInt(u+1);
+        out_.WriteChar('\n');
+    }
+    void Print(const char* event, std::size_t u, std::size_t v) {
+        out_.WriteString(event);
+        out_.WriteChar(' ');
+        out_.WriteInt(u+1);
+        out_.WriteChar(' ');
+        out_.WriteInt(v+1);
+        out_.WriteChar('\n');
+    }
+    OutputWriter& out_;
+};
+
+/**
+ * Strongly connected components algorithm, two pass Kosaraju,
+ * use with SccVisitor
  */
 template <typename Graph, typename Visitor>
 void StronglyConnectedComponents(Graph& graph, Graph& transposed_graph,  Visitor& visitor) {
@@ -258,132 +708,788 @@ void StronglyConnectedComponents(Graph& graph, Graph& transposed_graph,  Visitor
     DeepFirstSearch(transposed_graph, visitor, scc_visitor.visit_order);
 }
 
+/**
+ * Strongly connected components algorithm, single DFS pass,
+ * use with PearceSccVisitor
+ */
+template <typename Graph, typename Visitor>
+void StronglyConnectedComponents(Graph& graph, Visitor& visitor) {
+    DeepFirstSearch(graph, visitor);
+}
+
+/**
+ * Condensation of graph into DAG of its strongly connected components.
+ * Parallel edges are merged, components hold sizes, in and out degrees and
+ * compact (offsets + targets) list of successors. Buffers are kept between
+ * builds, so after warm up building does not allocate.
+ */
+class Condensation {
+public:
+    std::size_t scc_count;
+    std::vector<std::size_t> scc_sizes;
+    std::vector<std::size_t> in_degrees;
+    std::vector<std::size_t> out_degrees;
+    std::vector<std::size_t> scc_offsets;
+    std::vector<std::size_t> scc_targets;
+
+    Condensation() : scc_count(0) { }
+
+    /**
+     * Builds condensation from components assignment of SCC algorithm
+     */
+    template <typename Graph>
+    void Build(Graph& graph, std::vector<std::size_t>& vertices_roots, std::size_t count) {
+        scc_count = count;
+        scc_sizes.assign(scc_count, 0);
+        in_degrees.assign(scc_count, 0);
+        out_degrees.assign(scc_count, 0);
+        scc_offsets.assign(scc_count+1, 0);
+        scc_targets.clear();
+        last_source_.assign(scc_count, -1);
+
+        // Group vertices by component, counting sort
+        for (std::size_t u = 0; u < vertices_roots.size(); ++u)
+            ++scc_sizes[vertices_roots[u]];
+        members_offsets_.assign(scc_count+1, 0);
+        for (std::size_t c = 0; c < scc_count; ++c)
+            members_offsets_[c+1] = members_offsets_[c] + scc_sizes[c];
+        members_.resize(vertices_roots.size());
+        for (std::size_t u = 0; u < vertices_roots.size(); ++u)
+            members_[members_offsets_[vertices_roots[u]]++] = u;
+
+        // Edges leaving component, last_source_ filters repeated targets
+        std::size_t member = 0;
+        for (std::size_t c = 0; c < scc_count; ++c) {
+            scc_offsets[c] = scc_targets.size();
+            for (std::size_t end = member + scc_sizes[c]; member < end; ++member) {
+                for_outedge(edge_iterator, graph.EdgeListOf(members_[member])) {
+                    std::size_t d = vertices_roots[edge_iterator->dst];
+                    if (d == c || last_source_[d] == c)
+                        continue;
+                    last_source_[d] = c;
+                    scc_targets.push_back(d);
+                    ++in_degrees[d];
+                    ++out_degrees[c];
+                }
+            }
+        }
+        scc_offsets[scc_count] = scc_targets.size();
+    }
+
+// Data
+private:
+    std::vector<std::size_t> members_offsets_;
+    std::vector<std::size_t> members_;
+    std::vector<std::size_t> last_source_;
+};
+
+/**
+ * Fixed size pool of worker threads, tasks may submit more tasks
+ */
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+
+    explicit ThreadPool(std::size_t threads_count) : pending_(0), stop_(false) {
+        for (std::size_t i = 0; i < threads_count; ++i)
+            workers_.push_back(std::thread(&ThreadPool::Work, this));
+    }
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        work_ready_.notify_all();
+        for (std::size_t i = 0; i < workers_.size(); ++i)
+            workers_[i].join();
+    }
+
+    inline std::size_t ThreadsCount() const {
+        return workers_.size();
+    }
+
+    void Submit(Task task) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            tasks_.push_back(task);
+            ++pending_;
+        }
+        work_ready_.notify_one();
+    }
+
+    /**
+     * Block until all submitted tasks, and tasks they submitted, are done
+     */
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (pending_ > 0)
+            all_done_.wait(lock);
+    }
+
+private:
+    void Work() {
+        for (;;) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (!stop_ && tasks_.empty())
+                    work_ready_.wait(lock);
+                if (tasks_.empty())
+                    return;
+                task = tasks_.front();
+                tasks_.pop_front();
+            }
+            task();
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (--pending_ == 0)
+                all_done_.notify_all();
+        }
+    }
+
+// Data
+private:
+    std::vector<std::thread> workers_;
+    std::deque<Task> tasks_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable all_done_;
+    std::size_t pending_;
+    bool stop_;
+};
+
+/**
+ * Parallel SCC decomposition, forward-backward with trimming.
+ * Every vertex carries label of the subgraph it belongs to. A task owns all
+ * vertices of its label: trims vertices without in or out edges inside the
+ * subgraph (singleton components), then takes a pivot, marks its forward and
+ * backward closure and splits the rest into three new subgraphs, which are
+ * submitted to the pool or processed in place when small.
+ * Fills the same output fields as SccVisitor with the same partition and
+ * component sizes, but not the same ids: SccVisitor numbers components in
+ * order of its DFS on transposed graph, which has no parallel equivalent.
+ * Here components are numbered by their lowest vertex instead, so ids do
+ * not depend on threads scheduling. Condensation is the same graph up to
+ * this renumbering, which is all FindSourceComponent needs.
+ */
+template <typename Graph>
+class ParallelScc {
+public:
+    std::vector<std::size_t> vertices_roots;
+    std::vector<std::size_t> scc_sizes;
+    std::size_t scc_count;
+
+    ParallelScc(Graph& graph, Graph& transposed_graph, ThreadPool& pool)
+        : graph_(graph), transposed_graph_(transposed_graph), pool_(pool),
+          labels_(graph.VerticesCount()), marks_(graph.VerticesCount(), 0),
+          in_degrees_(graph.VerticesCount()), out_degrees_(graph.VerticesCount()),
+          next_label_(1), next_scc_id_(0) {
+        scc_count = 0;
+        vertices_roots.resize(graph.VerticesCount(), -1);
+        scc_sizes.resize(graph.VerticesCount());
+    }
+
+    void Run() {
+        graph_.Pack();
+        transposed_graph_.Pack();
+
+        std::vector<std::size_t> vertices(graph_.VerticesCount());
+        for (std::size_t u = 0; u < vertices.size(); ++u) {
+            vertices[u] = u;
+            labels_[u].store(0, std::memory_order_relaxed);
+        }
+        Submit(vertices, 0);
+        pool_.Wait();
+
+        Renumber();
+    }
+
+private:
+    // Subgraphs smaller than that are not worth a pool task
+    static const std::size_t SPAWN_SIZE = 4096;
+    static const std::size_t REMOVED = -1;
+    enum { FORWARD = 1, BACKWARD = 2 };
+
+    typedef std::pair<std::size_t, std::vector<std::size_t> > Subgraph;
+
+    void Submit(std::vector<std::size_t>& vertices, std::size_t label) {
+        std::vector<std::size_t>* task_vertices = new std::vector<std::size_t>();
+        task_vertices->swap(vertices);
+        pool_.Submit([this, task_vertices, label]() {
+            std::vector<Subgraph> work(1);
+            work.back().first = label;
+            work.back().second.swap(*task_vertices);
+            delete task_vertices;
+            Decompose(work);
+        });
+    }
+
+    inline bool Owns(std::size_t u, std::size_t label) {
+        return labels_[u].load(std::memory_order_relaxed) == label;
+    }
+
+    inline void Relabel(std::size_t u, std::size_t label) {
+        labels_[u].store(label, std::memory_order_relaxed);
+    }
+
+    inline void Settle(std::size_t u, std::size_t scc_id) {
+        Relabel(u, REMOVED);
+        vertices_roots[u] = scc_id;
+    }
+
+    void Decompose(std::vector<Subgraph>& work) {
+        std::vector<std::size_t> queue;
+        while (!work.empty()) {
+            std::size_t label = work.back().first;
+            std::vector<std::size_t> vertices;
+            vertices.swap(work.back().second);
+            work.pop_back();
+
+            Trim(vertices, label, queue);
+            if (vertices.empty())
+                continue;
+
+            // Forward and backward closure of pivot inside subgraph
+            std::size_t pivot = vertices.front();
+            Reach(graph_, pivot, label, FORWARD, queue);
+            Reach(transposed_graph_, pivot, label, BACKWARD, queue);
+
+            std::size_t scc_id = next_scc_id_++;
+            std::size_t child_labels[3] = { next_label_++, next_label_++, next_label_++ };
+            std::vector<std::size_t> children[3];
+            for (std::size_t i = 0; i < vertices.size(); ++i) {
+                std::size_t u = vertices[i];
+                int mark = marks_[u];
+                marks_[u] = 0;
+                if (mark == (FORWARD | BACKWARD)) {
+                    Settle(u, scc_id);
+                    continue;
+                }
+                Relabel(u, child_labels[mark]);
+                children[mark].push_back(u);
+            }
+
+            for (int i = 0; i < 3; ++i) {
+                if (children[i].empty())
+                    continue;
+                if (children[i].size() >= SPAWN_SIZE && pool_.ThreadsCount() > 1) {
+                    Submit(children[i], child_labels[i]);
+                } else {
+                    work.push_back(Subgraph());
+                    work.back().first = child_labels[i];
+                    work.back().second.swap(children[i]);
+                }
+            }
+        }
+    }
+
+    // Marks vertices of subgraph reachable from pivot
+    void Reach(Graph& graph, std::size_t pivot, std::size_t label, char mark,
+               std::vector<std::size_t>& queue) {
+        queue.clear();
+        queue.push_back(pivot);
+        marks_[pivot] |= mark;
+        for (std::size_t head = 0; head < queue.size(); ++head) {
+            for_outedge(edge_iterator, graph.EdgeListOf(queue[head])) {
+                std::size_t v = edge_iterator->dst;
+                if (Owns(v, label) && !(marks_[v] & mark)) {
+                    marks_[v] |= mark;
+                    queue.push_back(v);
+                }
+            }
+        }
+    }
+
+    // Repeatedly settles vertices with no in or out edge inside subgraph
+    void Trim(std::vector<std::size_t>& vertices, std::size_t label,
+              std::vector<std::size_t>& queue) {
+        queue.clear();
+        for (std::size_t i = 0; i < vertices.size(); ++i) {
+            std::size_t u = vertices[i];
+            out_degrees_[u] = CountOwned(graph_, u, label);
+            in_degrees_[u] = CountOwned(transposed_graph_, u, label);
+        }
+        for (std::size_t i = 0; i < vertices.size(); ++i) {
+            std::size_t u = vertices[i];
+            if (out_degrees_[u] == 0 || in_degrees_[u] == 0) {
+                Settle(u, next_scc_id_++);
+                queue.push_back(u);
+            }
+        }
+        for (std::size_t head = 0; head < queue.size(); ++head) {
+            std::size_t u = queue[head];
+            for_outedge(edge_iterator, graph_.EdgeListOf(u)) {
+                std::size_t v = edge_iterator->dst;
+                if (Owns(v, label) && --in_degrees_[v] == 0) {
+                    Settle(v, next_scc_id_++);
+                    queue.push_back(v);
+                }
+            }
+            for_outedge(edge_iterator, transposed_graph_.EdgeListOf(u)) {
+                std::size_t v = edge_iterator->dst;
+                if (Owns(v, label) && --out_degrees_[v] == 0) {
+                    Settle(v, next_scc_id_++);
+                    queue.push_back(v);
+                }
+            }
+        }
+        if (queue.empty())
+            return;
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < vertices.size(); ++i)
+            if (Owns(vertices[i], label))
+                vertices[kept++] = vertices[i];
+        vertices.resize(kept);
+    }
+
+    inline std::size_t CountOwned(Graph& graph, std::size_t u, std::size_t label) {
+        std::size_t count = 0;
+        for_outedge(edge_iterator, graph.EdgeListOf(u))
+            if (Owns(edge_iterator->dst, label))
+                ++count;
+        return count;
+    }
+
+    // Number components by lowest vertex
+    void Renumber() {
+        std::vector<std::size_t> ids(next_scc_id_, -1);
+        for (std::size_t u = 0; u < vertices_roots.size(); ++u) {
+            std::size_t& id = ids[vertices_roots[u]];
+            if (id == std::size_t(-1))
+                id = scc_count++;
+            vertices_roots[u] = id;
+            ++scc_sizes[id];
+        }
+    }
+
+// Data
+private:
+    Graph& graph_;
+    Graph& transposed_graph_;
+    ThreadPool& pool_;
+    std::vector<std::atomic<std::size_t> > labels_;
+    std::vector<char> marks_;
+    std::vector<std::size_t> in_degrees_;
+    std::vector<std::size_t> out_degrees_;
+    std::atomic<std::size_t> next_label_;
+    std::atomic<std::size_t> next_scc_id_;
+};
+
 class Algorithm {
-    typedef AdjacencyList Graph;
+    typedef CsrAdjacencyList Graph;
     Graph graph_;
-    Graph transposed_graph_;
-    //Graph graph_tr_;
+    ThreadPool* pool_;
+    Condensation& condensation_;
     std::size_t result;
+    template <typename SccOutput>
+    void FindSourceComponent(SccOutput& scc);
 public:
+    enum Engine { ENGINE_PEARCE, ENGINE_KOSARAJU };
+
+    // Engine of single thread runs, same for all test cases
+    static Engine engine;
+
+    Algorithm(ThreadPool* pool, Condensation& condensation)
+        : pool_(pool), condensation_(condensation) { }
     void ReadInput();
     void Run();
-    void PrintOutput();
+    void PrintOutput(OutputWriter& out);
+    void Trace(OutputWriter& out);
 };
 
+Algorithm::Engine Algorithm::engine = Algorithm::ENGINE_PEARCE;
+
 /**
- * Runs the algorithm - based on BFS
+ * Runs the algorithm - based on SCC, parallel when there is thread pool,
+ * otherwise one pass Pearce, or two pass Kosaraju kept as reference
  */
 void Algorithm::Run() {
-    SccVisitor<Graph> scc_visitor(graph_);
-    StronglyConnectedComponents(graph_, transposed_graph_, scc_visitor);
+    if (pool_ != NULL) {
+        Graph transposed_graph;
+        Transpose(graph_, transposed_graph);
+        ParallelScc<Graph> scc(graph_, transposed_graph, *pool_);
+        scc.Run();
+        FindSourceComponent(scc);
+    } else if (engine == ENGINE_KOSARAJU) {
+        Graph transposed_graph;
+        Transpose(graph_, transposed_graph);
+        SccVisitor<Graph> scc_visitor(graph_);
+        StronglyConnectedComponents(graph_, transposed_graph, scc_visitor);
+        FindSourceComponent(scc_visitor);
+    } else {
+        PearceSccVisitor<Graph> scc_visitor(graph_);
+        StronglyConnectedComponents(graph_, scc_visitor);
+        FindSourceComponent(scc_visitor);
+    }
+}
 
-    Graph transposed_scc_graph;
-    Transpose(scc_visitor.scc_graph, transposed_scc_graph);
+/**
+ * Result is size of the only component without incoming edges
+ */
+template <typename SccOutput>
+void Algorithm::FindSourceComponent(SccOutput& scc) {
+    condensation_.Build(graph_, scc.vertices_roots, scc.scc_count);
     result = 0;
     std::size_t noin_vertex_count = 0;
-    //D( transposed_scc_graph.VerticesCount() );
-    for (std::size_t i = 0; i < transposed_scc_graph.VerticesCount(); ++i) {
-        if (transposed_scc_graph.EdgeListOf(i).size() == 0) {
+    for (std::size_t i = 0; i < condensation_.scc_count; ++i) {
+        if (condensation_.in_degrees[i] == 0) {
             ++noin_vertex_count;
-            result = scc_visitor.scc_sizes[i];
+            result = condensation_.scc_sizes[i];
         }
-        // D( scc_visitor.scc_sizes[i] );
-        // D( transposed_scc_graph.EdgeListOf(i).size() );
     }
-    // D( "noin_vertex_count=" << noin_vertex_count );
-    // D( "result=" << result );
     if (noin_vertex_count > 1) {
         result = 0;
     }
-
-    //DebugPrinter<Graph> dprinter;
-    //DeepFirstSearch(transposed_scc_graph, dprinter);
-
-    // for (int i = 0; i < scc_visitor.scc.size(); ++i) {
-    //     for (int j = 0; j < scc_visitor.scc[i].size(); ++j)
-    //         std::cout << scc_visitor.scc[i][j]+1 << ", ";
-    //     std::cout << std::endl;
-    // }
-    // result = scc_visitor.tree_count;
 }
 
 /**
  * Parse input into Algorithm
  */
 void Algorithm::ReadInput() {
-    int participants_count;
-    scanf("%d", &participants_count);
-    graph_.CreateVertices(participants_count);
+    int participants_count = input.ReadInt();
+    Graph::EdgeBuffer edges;
     for (int participant = 1; participant <= participants_count; ++participant) {
-        int winner_count;
-        scanf("%d", &winner_count);
+        int winner_count = input.ReadInt();
         for (int winner = 1; winner <= winner_count; ++winner) {
-            int winner_id;
-            scanf("%d", &winner_id);
-            graph_.CreateEdge(winner_id-1, participant-1);
-            transposed_graph_.CreateEdge(participant-1, winner_id-1);
+            int winner_id = input.ReadInt();
+            OutEdge e = {(std::size_t)participant-1};
+            edges.push_back(Edge(e, winner_id-1));
         }
     }
+    graph_.Build(participants_count, edges);
 }
 
 /**
  * Prints the output
  */
-void Algorithm::PrintOutput() {
-    printf("%ld\n", result);
+void Algorithm::PrintOutput(OutputWriter& out) {
+    out.WriteInt(result);
+    out.WriteChar('\n');
+}
+
+/**
+ * Prints events of DFS over whole graph instead of result
+ */
+void Algorithm::Trace(OutputWriter& out) {
+    TraceVisitor<Graph> visitor(out);
+    DeepFirstSearch(graph_, visitor);
 }
 
 /**
  * Run single test case
  */
-void run_testcase() {
-    Algorithm algo;
+void run_testcase(ThreadPool* pool, Condensation& condensation) {
+    Algorithm algo(pool, condensation);
     algo.ReadInput();
     algo.Run();
-    algo.PrintOutput();
+    algo.PrintOutput(output);
 }
 
 /**
  * Main loop
  */
-void run_tests_loop() {
-    int test_number = 0;
-    scanf("%d", &test_number);
+void run_tests_loop(ThreadPool* pool) {
+    Condensation condensation;
+    int test_number = input.ReadInt();
     while (test_number--) {
-        run_testcase();
+        run_testcase(pool, condensation);
     }
 }
 
 /**
- * Main entry point
+ * Trace loop, DFS events of every test case
  */
-int main() {
-    run_tests_loop();
-    return 0;
+void run_traces_loop() {
+    Condensation condensation;
+    int test_number = input.ReadInt();
+    while (test_number--) {
+        Algorithm algo(NULL, condensation);
+        algo.ReadInput();
+        algo.Trace(output);
+    }
 }
 
+/**
+ * Solves test case into its own output
+ */
+void solve_case(Algorithm* algo, std::string* case_output) {
+    OutputWriter writer(case_output);
+    algo->Run();
+    algo->PrintOutput(writer);
+    writer.Flush();
+}
 
+/**
+ * Runs test cases in batches on pool of workers_count threads. Cases of
+ * batch are parsed in input order, solved in parallel, and printed in
+ * input order.
+ */
+void run_tests_batch(int workers_count) {
+    const int CASES_PER_WORKER = 4;
+    const int batch_size = workers_count * CASES_PER_WORKER;
+    ThreadPool pool(workers_count);
+    std::vector<Condensation> condensations(batch_size);
+    std::vector<std::string> outputs(batch_size);
+    std::vector<Algorithm*> cases;
+
+    int test_number = input.ReadInt();
+    while (test_number > 0) {
+        int count = std::min(test_number, batch_size);
+        test_number -= count;
+        cases.resize(count);
+        for (int i = 0; i < count; ++i) {
+            cases[i] = new Algorithm(NULL, condensations[i]);
+            cases[i]->ReadInput();
+            pool.Submit(std::bind(solve_case, cases[i], &outputs[i]));
+        }
+        pool.Wait();
 
+        for (int i = 0; i < count; ++i) {
+            output.Write(outputs[i]);
+            outputs[i].clear();
+            delete cases[i];
+        }
+    }
+}
 
+/**
+ * Bounded lock-free queue of single producer and single consumer.
+ * Push and Pop spin a while when queue is full or empty, then sleep on
+ * condition variable until other side moves, so stage waiting for I/O
+ * does not keep its core busy. Other side takes the mutex only when
+ * somebody sleeps.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity) : items_(capacity+1), head_(0), tail_(0), sleepers_(0) { }
+
+    bool TryPush(const T& item) {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        std::size_t next = (tail+1 == items_.size()) ? 0 : tail+1;
+        if (next == head_.load(std::memory_order_acquire))
+            return false;
+        items_[tail] = item;
+        tail_.store(next);
+        Wake();
+        return true;
+    }
 
+    bool TryPop(T& item) {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = items_[head];
+        head_.store((head+1 == items_.size()) ? 0 : head+1);
+        Wake();
+        return true;
+    }
 
+    void Push(const T& item) {
+        for (int spin = 0; !TryPush(item); ++spin) {
+            if (spin < SPIN_COUNT)
+                std::this_thread::yield();
+            else
+                Sleep(&SpscQueue::Full);
+        }
+    }
 
+    T Pop() {
+        T item;
+        for (int spin = 0; !TryPop(item); ++spin) {
+            if (spin < SPIN_COUNT)
+                std::this_thread::yield();
+            else
+                Sleep(&SpscQueue::Empty);
+        }
+        return item;
+    }
 
+private:
+    static const int SPIN_COUNT = 64;
 
+    bool Full() const {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        return ((tail+1 == items_.size()) ? 0 : tail+1) == head_.load();
+    }
 
+    bool Empty() const {
+        return head_.load(std::memory_order_relaxed) == tail_.load();
+    }
 
+    // Sleeper is counted before it checks the queue again, and the other
+    // side stores its index before it reads the count (both sequentially
+    // consistent), so either sleeper sees the change or it gets woken
+    void Sleep(bool (SpscQueue::*blocked)() const) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        while ((this->*blocked)())
+            wakeup_.wait(lock);
+        sleepers_.fetch_sub(1);
+    }
 
+    void Wake() {
+        if (sleepers_.load() == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        wakeup_.notify_all();
+    }
 
+// Data
+private:
+    std::vector<T> items_;
+    std::atomic<std::size_t> head_;
+    std::atomic<std::size_t> tail_;
+    std::atomic<int> sleepers_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+};
 
+/**
+ * Streaming runner of test cases: this thread parses cases, workers solve
+ * them and writer thread prints them in input order, all at the same time.
+ * Case i goes to worker i % workers_count, so every queue has single
+ * producer and single consumer. Cases live in fixed number of slots
+ * returned by writer to parser, so memory stays bounded for any input.
+ * Case type provides Read() and Solve(OutputWriter&).
+ */
+template <typename Case>
+class Pipeline {
+public:
+    explicit Pipeline(int workers_count)
+        : workers_count_(workers_count), slots_count_(workers_count * SLOTS_PER_WORKER),
+          free_slots_(slots_count_) {
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            to_solve_.push_back(new SpscQueue<Slot*>(slots_count_));
+            to_write_.push_back(new SpscQueue<Slot*>(slots_count_));
+        }
+        for (int i = 0; i < slots_count_; ++i) {
+            slots_.push_back(new Slot());
+            free_slots_.Push(slots_.back());
+        }
+    }
 
+    ~Pipeline() {
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            delete to_solve_[worker];
+            delete to_write_[worker];
+        }
+        for (int i = 0; i < slots_count_; ++i)
+            delete slots_[i];
+    }
 
+    void Run(int test_number) {
+        std::vector<std::thread> threads;
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            int cases_count = (test_number - worker + workers_count_ - 1) / workers_count_;
+            threads.push_back(std::thread(&Pipeline::Solve, this, worker, cases_count));
+        }
+        threads.push_back(std::thread(&Pipeline::Write, this, test_number));
 
+        for (int i = 0; i < test_number; ++i) {
+            Slot* slot = free_slots_.Pop();
+            slot->item.Read();
+            to_solve_[i % workers_count_]->Push(slot);
+        }
 
+        for (std::size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+    }
 
+private:
+    static const int SLOTS_PER_WORKER = 4;
+
+    struct Slot {
+        Case item;
+        std::string output;
+    };
+
+    void Solve(int worker, int cases_count) {
+        while (cases_count--) {
+            Slot* slot = to_solve_[worker]->Pop();
+            {
+                OutputWriter writer(&slot->output);
+                slot->item.Solve(writer);
+            }
+            to_write_[worker]->Push(slot);
+        }
+    }
 
+    void Write(int test_number) {
+        for (int i = 0; i < test_number; ++i) {
+            Slot* slot = to_write_[i % workers_count_]->Pop();
+            output.Write(slot->output);
+            slot->output.clear();
+            free_slots_.Push(slot);
+        }
+    }
 
+// Data
+private:
+    int workers_count_;
+    int slots_count_;
+    std::vector<Slot*> slots_;
+    SpscQueue<Slot*> free_slots_;
+    std::vector<SpscQueue<Slot*>*> to_solve_;
+    std::vector<SpscQueue<Slot*>*> to_write_;
+};
 
+/**
+ * Test case of pipeline mode, fresh Algorithm for every case
+ */
+struct PipelineCase {
+    Condensation condensation;
+    Algorithm* algo;
+    PipelineCase() : algo(NULL) { }
+    ~PipelineCase() { delete algo; }
+    void Read() {
+        delete algo;
+        algo = new Algorithm(NULL, condensation);
+        algo->ReadInput();
+    }
+    void Solve(OutputWriter& out) {
+        algo->Run();
+        algo->PrintOutput(out);
+    }
+};
 
+/**
+ * Main entry point, optional argument is number of SCC worker threads,
+ * "-j N" solves test cases on N threads instead, "-p N" streams them
+ * through pipeline with N solving threads, "trace" prints DFS events,
+ * "kosaraju" runs two pass SCC instead of Pearce on single thread
+ */
+int main(int argc, char* argv[]) {
+    int threads_count = 1;
+    int workers_count = 1;
+    int pipeline_workers = 0;
+    bool trace = false;
+    for (int arg = 1; arg < argc; ++arg) {
+        if (std::string(argv[arg]) == "trace")
+            trace = true;
+        else if (std::string(argv[arg]) == "kosaraju")
+            Algorithm::engine = Algorithm::ENGINE_KOSARAJU;
+        else if (std::string(argv[arg]) == "-j" && arg+1 < argc)
+            workers_count = atoi(argv[++arg]);
+        else if (std::string(argv[arg]) == "-p" && arg+1 < argc)
+            pipeline_workers = atoi(argv[++arg]);
+        else
+            threads_count = atoi(argv[arg]);
+    }
 
-
-
+    if (trace) {
+        run_traces_loop();
+    } else if (pipeline_workers > 0) {
+        Pipeline<PipelineCase> pipeline(pipeline_workers);
+        pipeline.Run(input.ReadInt());
+    } else if (workers_count > 1) {
+        run_tests_batch(workers_count);
+    } else if (threads_count > 1) {
+        ThreadPool pool(threads_count);
+        run_tests_loop(&pool);
+    } else {
+        run_tests_loop(NULL);
+    }
+    return 0;
+}
@@ -1,6 +1,19 @@
 #include <cstdio>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <queue>
+#include <functional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Works only with MSCS 10 + or gcc, clang or other compiler with __typeof
 #if (_MSC_VER >= 1600) 
@@ -10,6 +23,204 @@
 #define for_each(i, c) for ( var(i, (c).begin()); i != (c).end(); ++i)
 #define D(exp) std::cout << exp << std::endl
 
+/**
+ * Bulk reader of stdin. Regular file is mapped into memory at once,
+ * pipe is read in large blocks. Numbers and words are parsed straight
+ * from the buffer, no library call per token.
+ */
+class InputReader {
+public:
+    InputReader() : pos_(NULL), end_(NULL), mapped_(NULL), mapped_size_(0) {
+        struct stat info;
+        off_t offset = lseek(0, 0, SEEK_CUR);
+        if (fstat(0, &info) == 0 && S_ISREG(info.st_mode) && offset >= 0 && info.st_size > offset) {
+            void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, 0, 0);
+            if (data != MAP_FAILED) {
+                mapped_ = static_cast<char*>(data);
+                mapped_size_ = info.st_size;
+                pos_ = mapped_ + offset;
+                end_ = mapped_ + mapped_size_;
+            }
+        }
+    }
+
+    ~InputReader() {
+        if (mapped_ != NULL)
+            munmap(mapped_, mapped_size_);
+    }
+
+    /**
+     * Reads signed decimal number, like scanf("%d")
+     */
+    int ReadInt() {
+        SkipSpaces();
+        bool negative = false;
+        if (Peek() == '-' || Peek() == '+') {
+            negative = (*pos_ == '-');
+            ++pos_;
+        }
+        int value = 0;
+        for (int c = Peek(); c >= '0' && c <= '9'; c = Peek()) {
+            value = value * 10 + (c - '0');
+            ++pos_;
+        }
+        return negative ? -value : value;
+    }
+
+    /**
+     * Reads word into buffer, like scanf("%s"), returns its length
+     */
+    std::size_t ReadWord(char* word) {
+        SkipSpaces();
+        std::size_t length = 0;
+        for (int c = Peek(); c != EOF && c > ' '; c = Peek()) {
+            // Copy whole run of non space characters available in buffer
+            const char* run = pos_;
+            while (run != end_ && static_cast<unsigned char>(*run) > ' ')
+                ++run;
+            std::memcpy(word + length, pos_, run - pos_);
+            length += run - pos_;
+            pos_ = run;
+        }
+        word[length] = '\0';
+        return length;
+    }
+
+private:
+    static const std::size_t BLOCK_SIZE = 1 << 16;
+
+    inline int Peek() {
+        if (pos_ == end_ && !Refill())
+            return EOF;
+        return static_cast<unsigned char>(*pos_);
+    }
+
+    inline void SkipSpaces() {
+        for (int c = Peek(); c != EOF && c <= ' '; c = Peek())
+            ++pos_;
+    }
+
+    bool Refill() {
+        if (mapped_ != NULL)
+            return false;
+        ssize_t count = read(0, block_, BLOCK_SIZE);
+        if (count <= 0)
+            return false;
+        pos_ = block_;
+        end_ = block_ + count;
+        return true;
+    }
+
+// Data
+private:
+    const char* pos_;
+    const char* end_;
+    char* mapped_;
+    std::size_t mapped_size_;
+    char block_[BLOCK_SIZE];
+} input;
+
+/**
+ * Bulk writer to stdout. Output is formatted into large buffer and
+ * written out only when buffer fills up and at exit. Small numbers
+ * are copied from precomputed table of their digits. Writer given
+ * a string collects output there instead, to be written later.
+ */
+class OutputWriter {
+public:
+    explicit OutputWriter(std::string* capture = NULL) : pos_(buffer_), capture_(capture) {
+        for (int value = 0; value < SMALL_INTS; ++value) {
+            int length = 0;
+            for (int rest = value; rest > 0 || length == 0; rest /= 10)
+                ++length;
+            small_lengths_[value] = length;
+            for (int i = length-1, rest = value; i >= 0; --i, rest /= 10)
+                small_digits_[value][i] = '0' + rest % 10;
+        }
+    }
+
+    ~OutputWriter() {
+        Flush();
+    }
+
+    inline void WriteInt(int value) {
+        if (pos_ + MAX_INT_LENGTH > buffer_ + BUFFER_SIZE)
+            Flush();
+        if (value >= 0 && value < SMALL_INTS) {
+            std::memcpy(pos_, small_digits_[value], SMALL_DIGITS);
+            pos_ += small_lengths_[value];
+            return;
+        }
+        unsigned int rest = value;
+        if (value < 0) {
+            *pos_++ = '-';
+            rest = -rest;
+        }
+        char digits[MAX_INT_LENGTH];
+        int length = 0;
+        do {
+            digits[length++] = '0' + rest % 10;
+            rest /= 10;
+        } while (rest > 0);
+        while (length > 0)
+            *pos_++ = digits[--length];
+    }
+
+    inline void WriteChar(char c) {
+        if (pos_ == buffer_ + BUFFER_SIZE)
+            Flush();
+        *pos_++ = c;
+    }
+
+    void WriteString(const char* text) {
+        for (; *text != '\0'; ++text)
+            WriteChar(*text);
+    }
+
+    void Write(const std::string& text) {
+        if (pos_ + text.size() > buffer_ + BUFFER_SIZE)
+            Flush();
+        if (text.size() > (std::size_t)BUFFER_SIZE) {
+            WriteOut(text.data(), text.data() + text.size());
+            return;
+        }
+        std::memcpy(pos_, text.data(), text.size());
+        pos_ += text.size();
+    }
+
+    void Flush() {
+        WriteOut(buffer_, pos_);
+        pos_ = buffer_;
+    }
+
+private:
+    void WriteOut(const char* data, const char* end) {
+        if (capture_ != NULL) {
+            capture_->append(data, end);
+            return;
+        }
+        while (data < end) {
+            ssize_t count = write(1, data, end - data);
+            if (count <= 0)
+                break;
+            data += count;
+        }
+    }
+
+    static const int BUFFER_SIZE = 1 << 16;
+    static const int MAX_INT_LENGTH = 12;
+    static const int SMALL_INTS = 1000;
+    static const int SMALL_DIGITS = 4;
+
+// Data
+private:
+    char* pos_;
+    std::string* capture_;
+    char buffer_[BUFFER_SIZE];
+    char small_digits_[SMALL_INTS][SMALL_DIGITS];
+    char small_lengths_[SMALL_INTS];
+} output;
+
 /**
  * Edge
  */
@@ -18,51 +229,532 @@ struct Edge {
 };
 
 /**
- * Vertex
+ * "<" relation read from input, kept until graph is packed
  */
-struct Vertex {
-    std::vector<Edge> edges;
-    int sibling;
+struct PendingEdge {
+    int src;
+    int dst;
 };
 
 /**
- * Adjacency listt representation of graph
+ * Disjoint sets of vertices, union by rank with path compression
+ */
+class DisjointSets {
+public:
+    inline void Resize(std::size_t count) {
+        std::size_t old_count = parents_.size();
+        parents_.resize(count);
+        ranks_.resize(count, 0);
+        for (std::size_t i = old_count; i < count; ++i)
+            parents_[i] = i;
+    }
+    inline int Find(int u) {
+        int root = u;
+        while (parents_[root] != root)
+            root = parents_[root];
+        while (parents_[u] != root) {
+            int parent = parents_[u];
+            parents_[u] = root;
+            u = parent;
+        }
+        return root;
+    }
+    inline int Union(int u, int v) {
+        u = Find(u);
+        v = Find(v);
+        if (u == v)
+            return u;
+        if (ranks_[u] < ranks_[v])
+            std::swap(u, v);
+        parents_[v] = u;
+        if (ranks_[u] == ranks_[v])
+            ++ranks_[u];
+        return u;
+    }
+
+private:
+    std::vector<int> parents_;
+    std::vector<unsigned char> ranks_;
+};
+
+/**
+ * Compressed sparse row representation of graph. Vertices in "=="
+ * relation are kept in disjoint sets and "<" relations in flat buffer,
+ * until Contract() packs edges between class representatives into
+ * contiguous offset + target arrays, so graph takes O(V + E) memory.
  */
 class AdjacencyList {
 public:
-    typedef std::vector<Edge> OutgoingEdgeList;
-    typedef std::vector<Vertex> VertexOutgoingEdges;
+    /**
+     * View of a single vertex out-edges inside the packed target array
+     */
+    class OutgoingEdgeList {
+    public:
+        typedef Edge* iterator;
+        OutgoingEdgeList(Edge* first, Edge* last) : first_(first), last_(last) { }
+        inline iterator begin() const { return first_; }
+        inline iterator end() const { return last_; }
+        inline std::size_t size() const { return last_ - first_; }
+        inline Edge& operator[](std::size_t i) const { return first_[i]; }
+    private:
+        Edge* first_;
+        Edge* last_;
+    };
+
+    AdjacencyList() : vertices_count_(0) { }
 
     inline void CreateVertices(std::size_t u) {
-        vertices_.resize(u);
-        for (int i = 0; i < vertices_.size(); ++i)
-            vertices_[i].sibling = i;
+        vertices_count_ = u;
+        classes_.Resize(u);
+    }
+    inline void ReserveEdges(std::size_t edges) {
+        pending_edges_.reserve(edges);
     }
     inline void CreateEdge(int u, int v, int type) {
         int further = std::max(u, v);
-        if (further >= vertices_.size())
-            vertices_.resize(further+1);
+        if (further >= vertices_count_) {
+            vertices_count_ = further+1;
+            classes_.Resize(further+1);
+        }
         if (type == 0) {
-            std::swap(vertices_[v].sibling, vertices_[u].sibling);
+            classes_.Union(u, v);
             return;
         }
-        Edge e = { v };
-        EdgeListOf(u).push_back(e);
+        PendingEdge e = { u, v };
+        pending_edges_.push_back(e);
     }
-    inline Vertex& VertexAt(int u) {
-        return vertices_[u]; 
-    }
-    inline OutgoingEdgeList& EdgeListOf(int u) {
-        return vertices_[u].edges; 
+    inline OutgoingEdgeList EdgeListOf(int u) {
+        Edge* targets = targets_.empty() ? NULL : &targets_[0];
+        return OutgoingEdgeList(targets + offsets_[u], targets + offsets_[u+1]);
     }
     inline int VerticesCount() {
-        return vertices_.size();
+        return vertices_count_;
+    }
+    inline int Representative(int u) {
+        return classes_.Find(u);
     }
+    void Contract();
 
 private:
-    VertexOutgoingEdges vertices_;
+    int vertices_count_;
+    DisjointSets classes_;
+    std::vector<PendingEdge> pending_edges_;
+    std::vector<int> offsets_;
+    std::vector<Edge> targets_;
+};
+
+/**
+ * Contracts every "==" class into its representative and packs graph:
+ * first pass counts edges of every representative, second fills them
+ * in, pointing to representatives, so other vertices are left without
+ * edges. Buffer of relations is released afterwards.
+ */
+void AdjacencyList::Contract() {
+    offsets_.assign(vertices_count_+1, 0);
+    for_each(edge, pending_edges_) {
+        edge->src = classes_.Find(edge->src);
+        edge->dst = classes_.Find(edge->dst);
+        ++offsets_[edge->src+1];
+    }
+    for (int u = 0; u < vertices_count_; ++u)
+        offsets_[u+1] += offsets_[u];
+
+    targets_.resize(pending_edges_.size());
+    std::vector<int> positions(offsets_.begin(), offsets_.end()-1);
+    for_each(edge, pending_edges_) {
+        Edge e = { edge->dst };
+        targets_[positions[edge->src]++] = e;
+    }
+    std::vector<PendingEdge>().swap(pending_edges_);
+}
+
+/**
+ * DFS stack frame: vertex and position of next edge to visit
+ */
+struct DfsFrame {
+    int vertex;
+    int position;
 };
 
+/**
+ * Longest path layering of contracted graph by in-degrees, Kahn style:
+ * layer 0 are representatives without incoming edges, vertex joins next
+ * layer when its last incoming edge is removed, so layer index is depth
+ * of longest path to it. Vertices never reaching in-degree 0 lie on
+ * cycle. Big frontiers are split between threads, which remove edges
+ * with atomic decrements and collect next layer in own parts.
+ */
+class Layering {
+public:
+    Layering(AdjacencyList& graph, int threads_count)
+        : graph_(graph), threads_count_(threads_count),
+          in_degrees_(graph.VerticesCount()), parts_(threads_count) { }
+
+    /**
+     * Returns depth of longest path, or -1 when graph has cycle
+     */
+    int Run() {
+        int representatives = 0;
+        for (int u = 0; u < graph_.VerticesCount(); ++u) {
+            if (graph_.Representative(u) == u)
+                ++representatives;
+            for_each(edge, graph_.EdgeListOf(u))
+                Store(edge->dst, Load(edge->dst) + 1);
+        }
+        for (int u = 0; u < graph_.VerticesCount(); ++u)
+            if (Load(u) == 0 && graph_.Representative(u) == u)
+                frontier_.push_back(u);
+
+        int depth = -1;
+        int settled = 0;
+        while (!frontier_.empty()) {
+            ++depth;
+            settled += frontier_.size();
+            if (threads_count_ == 1 || frontier_.size() < PARALLEL_FRONTIER) {
+                parts_[0].clear();
+                RemoveEdges(0, frontier_.size(), parts_[0]);
+                frontier_.swap(parts_[0]);
+                continue;
+            }
+
+            std::vector<std::thread> workers;
+            std::size_t chunk = (frontier_.size() + threads_count_ - 1) / threads_count_;
+            for (int worker = 0; worker < threads_count_; ++worker) {
+                std::size_t first = std::min(frontier_.size(), worker * chunk);
+                std::size_t last = std::min(frontier_.size(), first + chunk);
+                parts_[worker].clear();
+                workers.push_back(std::thread(&Layering::RemoveEdgesShared, this, first, last, worker));
+            }
+            for (int worker = 0; worker < threads_count_; ++worker)
+                workers[worker].join();
+            frontier_.clear();
+            for (int worker = 0; worker < threads_count_; ++worker)
+                frontier_.insert(frontier_.end(), parts_[worker].begin(), parts_[worker].end());
+        }
+        return settled < representatives ? -1 : std::max(depth, 0);
+    }
+
+private:
+    // Frontiers smaller than that are not worth starting threads
+    static const std::size_t PARALLEL_FRONTIER = 1 << 14;
+
+    // Single thread owns whole frontier, plain load and store will do
+    inline int Load(int u) {
+        return in_degrees_[u].load(std::memory_order_relaxed);
+    }
+    inline void Store(int u, int value) {
+        in_degrees_[u].store(value, std::memory_order_relaxed);
+    }
+
+    void RemoveEdges(std::size_t first, std::size_t last, std::vector<int>& next) {
+        for (std::size_t i = first; i < last; ++i) {
+            for_each(edge, graph_.EdgeListOf(frontier_[i])) {
+                int left = Load(edge->dst) - 1;
+                Store(edge->dst, left);
+                if (left == 0)
+                    next.push_back(edge->dst);
+            }
+        }
+    }
+
+    // Vertex is pushed by thread removing its last edge, join of
+    // workers orders it before next layer
+    void RemoveEdgesShared(std::size_t first, std::size_t last, int worker) {
+        std::vector<int>& next = parts_[worker];
+        for (std::size_t i = first; i < last; ++i) {
+            for_each(edge, graph_.EdgeListOf(frontier_[i])) {
+                if (in_degrees_[edge->dst].fetch_sub(1, std::memory_order_relaxed) == 1)
+                    next.push_back(edge->dst);
+            }
+        }
+    }
+
+// Data
+private:
+    AdjacencyList& graph_;
+    int threads_count_;
+    std::vector<std::atomic<int> > in_degrees_;
+    std::vector<int> frontier_;
+    std::vector<std::vector<int> > parts_;
+};
+
+/**
+ * Topological order and longest path depths kept up to date while
+ * relations arrive one by one, Pearce-Kelly style. Every class
+ * representative holds position in order. Edge x -> y against order
+ * is fixed by searching forward from y and backward from x, only
+ * among vertices between their positions, then giving vertices found
+ * backward the lower of their positions. Reaching x from y means
+ * cycle, so relation is rejected and state is left as it was.
+ * Merge of classes a and b, with no path between them, inserts edges
+ * of smaller one into bigger one, so graph stays acyclic on the way.
+ * Vertex without relations is free to move, on its first one it is put
+ * at front or back of the order, so chains grow in O(1) per relation in
+ * either direction. Otherwise reordering visits only vertices between
+ * positions of edge ends, still O(V) per relation in the worst case and
+ * O(V^2) in total, e.g. for u < v against order of long related chains.
+ * Depths are pushed down successors only while it costs less than
+ * computing them again: when work since last LongestChain() exceeds
+ * size of graph, depths are left stale and recomputed along the order
+ * by next LongestChain(), so it is O(V + E) at most per batch.
+ */
+class IncrementalOrder {
+public:
+    explicit IncrementalOrder(int vertices_count = 0)
+        : front_(0), back_(0), edges_count_(0), work_(0), stale_(false), longest_(0) {
+        Grow(vertices_count);
+    }
+
+    /**
+     * Adds relation u < v when type is 1, u == v when type is 0,
+     * returns false and ignores it when it contradicts relations so far
+     */
+    bool Insert(int u, int v, int type) {
+        Grow(std::max(u, v)+1);
+        u = classes_.Find(u);
+        v = classes_.Find(v);
+        if (type != 0)
+            return InsertEdge(u, v);
+        return u == v || Merge(u, v);
+    }
+
+    /**
+     * Number of "<" steps on longest chain of relations so far
+     */
+    int LongestChain() {
+        if (stale_)
+            Recompute();
+        work_ = 0;
+        return longest_;
+    }
+
+private:
+    void Grow(int vertices_count) {
+        int old_count = order_.size();
+        if (vertices_count <= old_count)
+            return;
+        classes_.Resize(vertices_count);
+        outgoing_.resize(vertices_count);
+        incoming_.resize(vertices_count);
+        depths_.resize(vertices_count, 0);
+        marks_.resize(vertices_count, 0);
+        order_.resize(vertices_count);
+        for (int u = old_count; u < vertices_count; ++u)
+            order_[u] = back_++;
+    }
+
+    bool InsertEdge(int x, int y) {
+        if (x == y)
+            return false;
+        if (outgoing_[x].empty() && incoming_[x].empty())
+            order_[x] = --front_;
+        else if (outgoing_[y].empty() && incoming_[y].empty())
+            order_[y] = back_++;
+        if (order_[x] > order_[y]) {
+            if (SearchForward(y, x)) {
+                ClearMarks();
+                return false;
+            }
+            SearchBackward(x, order_[y]);
+            Reorder();
+        }
+        outgoing_[x].push_back(y);
+        incoming_[y].push_back(x);
+        ++edges_count_;
+        Raise(y, depths_[x] + 1);
+        return true;
+    }
+
+    bool Merge(int a, int b) {
+        if (outgoing_[a].size() + incoming_[a].size() < outgoing_[b].size() + incoming_[b].size())
+            std::swap(a, b);
+        int first = order_[a] < order_[b] ? a : b;
+        bool joined = SearchForward(first, first == a ? b : a);
+        ClearMarks();
+        if (joined)
+            return false;
+
+        // Edges of b given to a, neither can close cycle
+        for (std::size_t i = 0; i < incoming_[b].size(); ++i)
+            InsertEdge(classes_.Find(incoming_[b][i]), a);
+        for (std::size_t i = 0; i < outgoing_[b].size(); ++i)
+            InsertEdge(a, classes_.Find(outgoing_[b][i]));
+
+        int depth = std::max(depths_[a], depths_[b]);
+        int root = classes_.Union(a, b);
+        if (root != a) {
+            order_[root] = order_[a];
+            depths_[root] = depths_[a];
+            outgoing_[root].swap(outgoing_[a]);
+            incoming_[root].swap(incoming_[a]);
+        }
+        int other = root == a ? b : a;
+        std::vector<int>().swap(outgoing_[other]);
+        std::vector<int>().swap(incoming_[other]);
+        Raise(root, depth);
+        return true;
+    }
+
+    /**
+     * DFS from start over vertices placed before target, returns true
+     * when target is reached
+     */
+    bool SearchForward(int start, int target) {
+        int bound = order_[target];
+        forward_.clear();
+        stack_.assign(1, start);
+        marks_[start] = 1;
+        while (!stack_.empty()) {
+            int u = stack_.back();
+            stack_.pop_back();
+            forward_.push_back(u);
+            for_each(edge, outgoing_[u]) {
+                int w = classes_.Find(*edge);
+                if (w == target)
+                    return true;
+                if (!marks_[w] && order_[w] < bound) {
+                    marks_[w] = 1;
+                    stack_.push_back(w);
+                }
+            }
+        }
+        return false;
+    }
+
+    void SearchBackward(int start, int bound) {
+        backward_.clear();
+        stack_.assign(1, start);
+        marks_[start] = 1;
+        while (!stack_.empty()) {
+            int u = stack_.back();
+            stack_.pop_back();
+            backward_.push_back(u);
+            for_each(edge, incoming_[u]) {
+                int w = classes_.Find(*edge);
+                if (!marks_[w] && order_[w] > bound) {
+                    marks_[w] = 1;
+                    stack_.push_back(w);
+                }
+            }
+        }
+    }
+
+    struct ByOrder {
+        const std::vector<int>& order;
+        bool operator()(int u, int v) const { return order[u] < order[v]; }
+    };
+
+    // Vertices found backward take lowest of freed positions, in their
+    // old relative order, vertices found forward take the rest
+    void Reorder() {
+        ByOrder by_order = { order_ };
+        std::sort(backward_.begin(), backward_.end(), by_order);
+        std::sort(forward_.begin(), forward_.end(), by_order);
+        positions_.clear();
+        for_each(u, backward_)
+            positions_.push_back(order_[*u]);
+        for_each(u, forward_)
+            positions_.push_back(order_[*u]);
+        std::sort(positions_.begin(), positions_.end());
+        std::size_t next = 0;
+        for_each(u, backward_)
+            order_[*u] = positions_[next++];
+        for_each(u, forward_)
+            order_[*u] = positions_[next++];
+        ClearMarks();
+    }
+
+    void ClearMarks() {
+        for_each(u, forward_)
+            marks_[*u] = 0;
+        for_each(u, backward_)
+            marks_[*u] = 0;
+        for_each(u, stack_)
+            marks_[*u] = 0;
+        forward_.clear();
+        backward_.clear();
+        stack_.clear();
+    }
+
+    /**
+     * Raises depth of u and pushes it down its successors in
+     * topological order, so every vertex is settled once. Gives up
+     * and leaves depths stale when work exceeds size of graph.
+     */
+    void Raise(int u, int depth) {
+        if (stale_ || depth <= depths_[u])
+            return;
+        depths_[u] = depth;
+        longest_ = std::max(longest_, depth);
+        std::size_t budget = order_.size() + edges_count_;
+        pending_.push(std::make_pair(order_[u], u));
+        while (!pending_.empty()) {
+            int v = pending_.top().second;
+            pending_.pop();
+            work_ += outgoing_[v].size() + 1;
+            if (work_ > budget) {
+                stale_ = true;
+                while (!pending_.empty())
+                    pending_.pop();
+                return;
+            }
+            for_each(edge, outgoing_[v]) {
+                int w = classes_.Find(*edge);
+                if (depths_[v] + 1 <= depths_[w])
+                    continue;
+                depths_[w] = depths_[v] + 1;
+                longest_ = std::max(longest_, depths_[w]);
+                pending_.push(std::make_pair(order_[w], w));
+            }
+        }
+    }
+
+    /**
+     * Computes depths of all representatives again, visiting them
+     * by their positions in topological order
+     */
+    void Recompute() {
+        positions_.assign(back_ - front_, -1);
+        for (int u = 0; u < (int)order_.size(); ++u) {
+            if (classes_.Find(u) == u) {
+                positions_[order_[u] - front_] = u;
+                depths_[u] = 0;
+            }
+        }
+        longest_ = 0;
+        for_each(u, positions_) {
+            if (*u < 0)
+                continue;
+            longest_ = std::max(longest_, depths_[*u]);
+            for_each(edge, outgoing_[*u]) {
+                int w = classes_.Find(*edge);
+                depths_[w] = std::max(depths_[w], depths_[*u] + 1);
+            }
+        }
+        stale_ = false;
+    }
+
+// Data
+private:
+    DisjointSets classes_;
+    std::vector<std::vector<int> > outgoing_;
+    std::vector<std::vector<int> > incoming_;
+    std::vector<int> order_;
+    int front_;
+    int back_;
+    std::vector<int> depths_;
+    std::vector<char> marks_;
+    std::vector<int> forward_;
+    std::vector<int> backward_;
+    std::vector<int> stack_;
+    std::vector<int> positions_;
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int> >,
+                        std::greater<std::pair<int, int> > > pending_;
+    std::size_t edges_count_;
+    std::size_t work_;
+    bool stale_;
+    int longest_;
+};
 
 class Algorithm {
     AdjacencyList graph_;
@@ -70,26 +762,41 @@ class Algorithm {
     int result;
     std::vector<int> finish_times_;
     std::vector<int> depths_;
+    std::vector<DfsFrame> dfs_stack_;
 public:
+    enum Engine { ENGINE_DFS, ENGINE_LAYERS, ENGINE_INCREMENTAL };
+
+    Algorithm() : engine_(ENGINE_DFS), threads_count_(1), contradiction_(false) { }
+    void SetEngine(Engine engine) { engine_ = engine; }
+    void SetThreadsCount(int threads_count) { threads_count_ = threads_count; }
     void ReadInput();
+    void ReadIncremental(int vertices, int edges);
     void Run();
-    void PrintOutput();
+    void PrintOutput(OutputWriter& out);
     void TopologicDfsVisit(int u);
-    int MinSibling(int u);
-};
+private:
+    Engine engine_;
+    int threads_count_;
+    IncrementalOrder incremental_;
+    bool contradiction_;
+} algo;
 
 /**
  * Read input parameters
  */ 
 void Algorithm::ReadInput() {
-    int vertices, edges;
-    scanf("%d %d", &vertices, &edges);
+    int vertices = input.ReadInt();
+    int edges = input.ReadInt();
+    if (engine_ == ENGINE_INCREMENTAL) {
+        ReadIncremental(vertices, edges);
+        return;
+    }
     graph_.CreateVertices(vertices);
-    for (int i = 0; i < vertices; ++i)
-        graph_.EdgeListOf(i).reserve(edges);
+    graph_.ReserveEdges(edges);
     while (edges--) {
-        int u, v, relation;
-        scanf("%d %d %d", &u, &v, &relation);
+        int u = input.ReadInt();
+        int v = input.ReadInt();
+        int relation = input.ReadInt();
         --u; --v;
         if (relation == -1) // <
             graph_.CreateEdge(u, v, 1);
@@ -100,23 +807,61 @@ void Algorithm::ReadInput() {
     }
 }
 
+/**
+ * Inserts relations into incremental order as they are read, relations
+ * after first contradiction are only skipped
+ */
+void Algorithm::ReadIncremental(int vertices, int edges) {
+    incremental_ = IncrementalOrder(vertices);
+    contradiction_ = false;
+    while (edges--) {
+        int u = input.ReadInt();
+        int v = input.ReadInt();
+        int relation = input.ReadInt();
+        if (contradiction_)
+            continue;
+        --u; --v;
+        if (relation == -1) // <
+            contradiction_ = !incremental_.Insert(u, v, 1);
+        else if (relation == 1) // >
+            contradiction_ = !incremental_.Insert(v, u, 1);
+        else // ==
+            contradiction_ = !incremental_.Insert(v, u, 0);
+    }
+}
+
 /**
  * Executes algorithm
  */ 
 void Algorithm::Run() {
+    if (engine_ == ENGINE_INCREMENTAL) {
+        result = contradiction_ ? -1 : incremental_.LongestChain();
+        return;
+    }
     finish_timer_ = 0;
     result = 0;
     finish_times_.resize(graph_.VerticesCount(), -1);
     depths_.resize(graph_.VerticesCount(),  -1);
+    graph_.Contract();
+    if (engine_ == ENGINE_LAYERS) {
+        Layering layering(graph_, threads_count_);
+        result = layering.Run();
+        return;
+    }
+
+    dfs_stack_.reserve(graph_.VerticesCount());
 
+    // Only representatives of "==" classes are left in the graph
     for (int vertex = 0; vertex < graph_.VerticesCount(); ++vertex)
-        if (depths_[vertex] == -1)
+        if (depths_[vertex] == -1 && graph_.Representative(vertex) == vertex)
             TopologicDfsVisit(vertex);
 
+    // Edge not going to vertex finished earlier closes cycle, "<"
+    // inside one class is loop of contracted graph
     for (int vertex = 0; vertex < graph_.VerticesCount(); ++vertex) {
         result = std::max(result, depths_[vertex]);
         for_each(edge, graph_.EdgeListOf(vertex)) {
-            int v = MinSibling(edge->dst);
+            int v = edge->dst;
             if (finish_times_[vertex] <= finish_times_[v]) {
                 result = -1;
                 return;
@@ -126,58 +871,334 @@ void Algorithm::Run() {
 }
 
 /**
- * Toologicly orderging DFS visit
+ * Toologicly orderging DFS visit, iterative with explicit frame stack.
+ * Frame position walks out-edges of contracted graph.
  */ 
 void Algorithm::TopologicDfsVisit(int u) {
+    dfs_stack_.clear();
     depths_[u] = 0;
-    // Visit all adjacent nodes
-    for_each(edge, graph_.EdgeListOf(u)) {
-        if (depths_[edge->dst] == -1)
-            TopologicDfsVisit(edge->dst);
-        depths_[u] = std::max(depths_[u], depths_[edge->dst]+1);
-    }
+    DfsFrame root = { u, 0 };
+    dfs_stack_.push_back(root);
 
-    // Visit nodes on cyclic list representing "==" relation
-    if (graph_.VertexAt(u).sibling != u) {
-        if (depths_[graph_.VertexAt(u).sibling] == -1)
-            TopologicDfsVisit(graph_.VertexAt(u).sibling);
-        depths_[u] = std::max(depths_[u], depths_[graph_.VertexAt(u).sibling]);
-    }
+    while (!dfs_stack_.empty()) {
+        DfsFrame& frame = dfs_stack_.back();
+        int vertex = frame.vertex;
+        AdjacencyList::OutgoingEdgeList edges = graph_.EdgeListOf(vertex);
 
-    finish_times_[u] = ++finish_timer_;
-}
+        // Visit all adjacent nodes
+        if (frame.position < (int)edges.size()) {
+            int dst = edges[frame.position].dst;
+            if (depths_[dst] == -1) {
+                depths_[dst] = 0;
+                DfsFrame child = { dst, 0 };
+                dfs_stack_.push_back(child);
+                continue;
+            }
+            depths_[vertex] = std::max(depths_[vertex], depths_[dst]+1);
+            ++frame.position;
+            continue;
+        }
 
-int Algorithm::MinSibling(int u) {
-    int start = u;
-    int result = u;
-    while (graph_.VertexAt(u).sibling != start) {
-        u = graph_.VertexAt(u).sibling;
-        result = std::min(result, u);
+        finish_times_[vertex] = ++finish_timer_;
+        dfs_stack_.pop_back();
     }
-    return result;
 }
 
 /**
  * Prints result
  */ 
-void Algorithm::PrintOutput() {
-    if (result >= 0)
-        printf("%d\n", result);
-    else
-        printf("NO\n");
+void Algorithm::PrintOutput(OutputWriter& out) {
+    if (result >= 0) {
+        out.WriteInt(result);
+        out.WriteChar('\n');
+    } else {
+        out.WriteString("NO\n");
+    }
+}
+
+/**
+ * Solves every step-th case of batch starting from first,
+ * each into its own output
+ */
+void solve_cases(std::vector<Algorithm*>* cases, std::vector<std::string>* outputs, int first, int step) {
+    for (std::size_t i = first; i < cases->size(); i += step) {
+        OutputWriter writer(&(*outputs)[i]);
+        (*cases)[i]->Run();
+        (*cases)[i]->PrintOutput(writer);
+        writer.Flush();
+    }
+}
+
+/**
+ * Runs test cases in batches on workers_count threads. Cases of batch are
+ * parsed in input order, solved in parallel, and printed in input order.
+ */
+void run_tests_batch(int test_number, int workers_count) {
+    const int CASES_PER_WORKER = 4;
+    std::vector<Algorithm*> cases;
+    std::vector<std::string> outputs(workers_count * CASES_PER_WORKER);
+    while (test_number > 0) {
+        int count = std::min(test_number, workers_count * CASES_PER_WORKER);
+        test_number -= count;
+        cases.resize(count);
+        for (int i = 0; i < count; ++i) {
+            cases[i] = new Algorithm(::algo);
+            cases[i]->ReadInput();
+        }
+
+        std::vector<std::thread> workers;
+        for (int worker = 0; worker < workers_count; ++worker)
+            workers.push_back(std::thread(solve_cases, &cases, &outputs, worker, workers_count));
+        for (int worker = 0; worker < workers_count; ++worker)
+            workers[worker].join();
+
+        for (int i = 0; i < count; ++i) {
+            output.Write(outputs[i]);
+            outputs[i].clear();
+            delete cases[i];
+        }
+    }
 }
 
 /**
- * Main entry point
+ * Bounded lock-free queue of single producer and single consumer.
+ * Push and Pop spin a while when queue is full or empty, then sleep on
+ * condition variable until other side moves, so stage waiting for I/O
+ * does not keep its core busy. Other side takes the mutex only when
+ * somebody sleeps.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity) : items_(capacity+1), head_(0), tail_(0), sleepers_(0) { }
+
+    bool TryPush(const T& item) {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        std::size_t next = (tail+1 == items_.size()) ? 0 : tail+1;
+        if (next == head_.load(std::memory_order_acquire))
+            return false;
+        items_[tail] = item;
+        tail_.store(next);
+        Wake();
+        return true;
+    }
+
+    bool TryPop(T& item) {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = items_[head];
+        head_.store((head+1 == items_.size()) ? 0 : head+1);
+        Wake();
+        return true;
+    }
+
+    void Push(const T& item) {
+        for (int spin = 0; !TryPush(item); ++spin) {
+            if (spin < SPIN_COUNT)
+                std::this_thread::yield();
+            else
+                Sleep(&SpscQueue::Full);
+        }
+    }
+
+    T Pop() {
+        T item;
+        for (int spin = 0; !TryPop(item); ++spin) {
+            if (spin < SPIN_COUNT)
+                std::this_thread::yield();
+            else
+                Sleep(&SpscQueue::Empty);
+        }
+        return item;
+    }
+
+private:
+    static const int SPIN_COUNT = 64;
+
+    bool Full() const {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        return ((tail+1 == items_.size()) ? 0 : tail+1) == head_.load();
+    }
+
+    bool Empty() const {
+        return head_.load(std::memory_order_relaxed) == tail_.load();
+    }
+
+    // Sleeper is counted before it checks the queue again, and the other
+    // side stores its index before it reads the count (both sequentially
+    // consistent), so either sleeper sees the change or it gets woken
+    void Sleep(bool (SpscQueue::*blocked)() const) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        while ((this->*blocked)())
+            wakeup_.wait(lock);
+        sleepers_.fetch_sub(1);
+    }
+
+    void Wake() {
+        if (sleepers_.load() == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        wakeup_.notify_all();
+    }
+
+// Data
+private:
+    std::vector<T> items_;
+    std::atomic<std::size_t> head_;
+    std::atomic<std::size_t> tail_;
+    std::atomic<int> sleepers_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+};
+
+/**
+ * Streaming runner of test cases: this thread parses cases, workers solve
+ * them and writer thread prints them in input order, all at the same time.
+ * Case i goes to worker i % workers_count, so every queue has single
+ * producer and single consumer. Cases live in fixed number of slots
+ * returned by writer to parser, so memory stays bounded for any input.
+ * Case type provides Read() and Solve(OutputWriter&).
+ */
+template <typename Case>
+class Pipeline {
+public:
+    explicit Pipeline(int workers_count)
+        : workers_count_(workers_count), slots_count_(workers_count * SLOTS_PER_WORKER),
+          free_slots_(slots_count_) {
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            to_solve_.push_back(new SpscQueue<Slot*>(slots_count_));
+            to_write_.push_back(new SpscQueue<Slot*>(slots_count_));
+        }
+        for (int i = 0; i < slots_count_; ++i) {
+            slots_.push_back(new Slot());
+            free_slots_.Push(slots_.back());
+        }
+    }
+
+    ~Pipeline() {
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            delete to_solve_[worker];
+            delete to_write_[worker];
+        }
+        for (int i = 0; i < slots_count_; ++i)
+            delete slots_[i];
+    }
+
+    void Run(int test_number) {
+        std::vector<std::thread> threads;
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            int cases_count = (test_number - worker + workers_count_ - 1) / workers_count_;
+            threads.push_back(std::thread(&Pipeline::Solve, this, worker, cases_count));
+        }
+        threads.push_back(std::thread(&Pipeline::Write, this, test_number));
+
+        for (int i = 0; i < test_number; ++i) {
+            Slot* slot = free_slots_.Pop();
+            slot->item.Read();
+            to_solve_[i % workers_count_]->Push(slot);
+        }
+
+        for (std::size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+    }
+
+private:
+    static const int SLOTS_PER_WORKER = 4;
+
+    struct Slot {
+        Case item;
+        std::string output;
+    };
+
+    void Solve(int worker, int cases_count) {
+        while (cases_count--) {
+            Slot* slot = to_solve_[worker]->Pop();
+            {
+                OutputWriter writer(&slot->output);
+                slot->item.Solve(writer);
+            }
+            to_write_[worker]->Push(slot);
+        }
+    }
+
+    void Write(int test_number) {
+        for (int i = 0; i < test_number; ++i) {
+            Slot* slot = to_write_[i % workers_count_]->Pop();
+            output.Write(slot->output);
+            slot->output.clear();
+            free_slots_.Push(slot);
+        }
+    }
+
+// Data
+private:
+    int workers_count_;
+    int slots_count_;
+    std::vector<Slot*> slots_;
+    SpscQueue<Slot*> free_slots_;
+    std::vector<SpscQueue<Slot*>*> to_solve_;
+    std::vector<SpscQueue<Slot*>*> to_write_;
+};
+
+/**
+ * Test case of pipeline mode, fresh copy of Algorithm settings for
+ * every case
+ */
+struct PipelineCase {
+    Algorithm* algo;
+    PipelineCase() : algo(NULL) { }
+    ~PipelineCase() { delete algo; }
+    void Read() {
+        delete algo;
+        algo = new Algorithm(::algo);
+        algo->ReadInput();
+    }
+    void Solve(OutputWriter& out) {
+        algo->Run();
+        algo->PrintOutput(out);
+    }
+};
+
+/**
+ * Main entry point, "-j N" solves test cases on N threads,
+ * "-p N" streams them through pipeline with N solving threads,
+ * "layers" orders graph by in-degree layering instead of DFS,
+ * with frontier split between N threads when number N is given,
+ * "incremental" keeps order up to date while relations are read
  */ 
 int main(int argc, char* argv[]) {
-    int test_number = 0;
-    scanf("%d", &test_number);
+    int workers_count = 1;
+    int pipeline_workers = 0;
+    for (int arg = 1; arg < argc; ++arg) {
+        if (std::strcmp(argv[arg], "layers") == 0)
+            algo.SetEngine(Algorithm::ENGINE_LAYERS);
+        else if (std::strcmp(argv[arg], "incremental") == 0)
+            algo.SetEngine(Algorithm::ENGINE_INCREMENTAL);
+        else if (std::strcmp(argv[arg], "-j") == 0 && arg+1 < argc)
+            workers_count = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "-p") == 0 && arg+1 < argc)
+            pipeline_workers = std::atoi(argv[++arg]);
+        else if (std::atoi(argv[arg]) > 0)
+            algo.SetThreadsCount(std::atoi(argv[arg]));
+    }
+
+    int test_number = input.ReadInt();
+    if (pipeline_workers > 0) {
+        Pipeline<PipelineCase> pipeline(pipeline_workers);
+        pipeline.Run(test_number);
+        return 0;
+    }
+    if (workers_count > 1) {
+        run_tests_batch(test_number, workers_count);
+        return 0;
+    }
     while (test_number--) {
-        Algorithm algo;
-        algo.ReadInput();
-        algo.Run();
-        algo.PrintOutput();
+        Algorithm solver(algo);
+        solver.ReadInput();
+        solver.Run();
+        solver.PrintOutput(output);
     }
     return 0;
 }
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+"""Peak memory regression check of spoj070 on large sparse input.
+
+Usage: spoj070_rss.py ./spoj070 [engine arguments...]
+
+Generates one case of 10^6 vertices and 3*10^6 random relations consistent
+with hidden ranks (about 47MB), runs the program on it and fails when its
+peak RSS exceeds LIMIT_MB. Graph is O(V + E), build from commit measured
+103MB; per-vertex edge list reservation it replaced needed V*E slots and
+was killed out of memory here.
+"""
+import os
+import random
+import resource
+import subprocess
+import sys
+import tempfile
+
+VERTICES = 1000000
+RELATIONS = 3000000
+LIMIT_MB = 256
+
+
+def generate(out):
+    rng = random.Random(70)
+    rank = [rng.randrange(100) for _ in range(VERTICES + 1)]
+    out.write("1\n%d %d\n" % (VERTICES, RELATIONS))
+    lines = []
+    for _ in range(RELATIONS):
+        u = rng.randint(1, VERTICES)
+        v = rng.randint(1, VERTICES)
+        relation = (rank[u] > rank[v]) - (rank[u] < rank[v])
+        lines.append("%d %d %d\n" % (u, v, relation))
+        if len(lines) == 100000:
+            out.writelines(lines)
+            lines = []
+    out.writelines(lines)
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    with tempfile.NamedTemporaryFile("w", suffix=".txt", delete=False) as case:
+        generate(case)
+    try:
+        with open(case.name) as stdin, open(os.devnull, "w") as stdout:
+            code = subprocess.call(sys.argv[1:], stdin=stdin, stdout=stdout)
+    finally:
+        os.unlink(case.name)
+    peak_mb = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss // 1024
+    print("exit %d, peak RSS %dMB, limit %dMB" % (code, peak_mb, LIMIT_MB))
+    sys.exit(0 if code == 0 and peak_mb <= LIMIT_MB else 1)
+
+
+if __name__ == "__main__":
+    main()
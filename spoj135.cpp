@@ -5,6 +5,18 @@
 #include <numeric>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Use only what is neded
 using std::queue;
@@ -28,8 +40,207 @@ int lcm(int a, int b) {
 }
 
 
+/**
+ * Bulk reader of stdin. Regular file is mapped into memory at once,
+ * pipe is read in large blocks. Numbers and words are parsed straight
+ * from the buffer, no library call per token.
+ */
+class InputReader {
+public:
+	InputReader() : pos_(NULL), end_(NULL), mapped_(NULL), mapped_size_(0) {
+		struct stat info;
+		off_t offset = lseek(0, 0, SEEK_CUR);
+		if (fstat(0, &info) == 0 && S_ISREG(info.st_mode) && offset >= 0 && info.st_size > offset) {
+			void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, 0, 0);
+			if (data != MAP_FAILED) {
+				mapped_ = static_cast<char*>(data);
+				mapped_size_ = info.st_size;
+				pos_ = mapped_ + offset;
+				end_ = mapped_ + mapped_size_;
+			}
+		}
+	}
+
+	~InputReader() {
+		if (mapped_ != NULL)
+			munmap(mapped_, mapped_size_);
+	}
+
+	/**
+	 * Reads signed decimal number, like scanf("%d")
+	 */
+	int ReadInt() {
+		SkipSpaces();
+		bool negative = false;
+		if (Peek() == '-' || Peek() == '+') {
+			negative = (*pos_ == '-');
+			++pos_;
+		}
+		int value = 0;
+		for (int c = Peek(); c >= '0' && c <= '9'; c = Peek()) {
+			value = value * 10 + (c - '0');
+			++pos_;
+		}
+		return negative ? -value : value;
+	}
+
+	/**
+	 * Reads word into buffer, like scanf("%s"), returns its length
+	 */
+	std::size_t ReadWord(char* word) {
+		SkipSpaces();
+		std::size_t length = 0;
+		for (int c = Peek(); c != EOF && c > ' '; c = Peek()) {
+			// Copy whole run of non space characters available in buffer
+			const char* run = pos_;
+			while (run != end_ && static_cast<unsigned char>(*run) > ' ')
+				++run;
+			std::memcpy(word + length, pos_, run - pos_);
+			length += run - pos_;
+			pos_ = run;
+		}
+		word[length] = '\0';
+		return length;
+	}
+
+private:
+	static const std::size_t BLOCK_SIZE = 1 << 16;
+
+	inline int Peek() {
+		if (pos_ == end_ && !Refill())
+			return EOF;
+		return static_cast<unsigned char>(*pos_);
+	}
+
+	inline void SkipSpaces() {
+		for (int c = Peek(); c != EOF && c <= ' '; c = Peek())
+			++pos_;
+	}
+
+	bool Refill() {
+		if (mapped_ != NULL)
+			return false;
+		ssize_t count = read(0, block_, BLOCK_SIZE);
+		if (count <= 0)
+			return false;
+		pos_ = block_;
+		end_ = block_ + count;
+		return true;
+	}
+
+// Data
+private:
+	const char* pos_;
+	const char* end_;
+	char* mapped_;
+	std::size_t mapped_size_;
+	char block_[BLOCK_SIZE];
+} input;
+
+/**
+ * Bulk writer to stdout. Output is formatted into large buffer and
+ * written out only when buffer fills up and at exit. Small numbers
+ * are copied from precomputed table of their digits. Writer given
+ * a string collects output there instead, to be written later.
+ */
+class OutputWriter {
+public:
+	explicit OutputWriter(std::string* capture = NULL) : pos_(buffer_), capture_(capture) {
+		for (int value = 0; value < SMALL_INTS; ++value) {
+			int length = 0;
+			for (int rest = value; rest > 0 || length == 0; rest /= 10)
+				++length;
+			small_lengths_[value] = length;
+			for (int i = length-1, rest = value; i >= 0; --i, rest /= 10)
+				small_digits_[value][i] = '0' + rest % 10;
+		}
+	}
+
+	~OutputWriter() {
+		Flush();
+	}
+
+	inline void WriteInt(int value) {
+		if (pos_ + MAX_INT_LENGTH > buffer_ + BUFFER_SIZE)
+			Flush();
+		if (value >= 0 && value < SMALL_INTS) {
+			std::memcpy(pos_, small_digits_[value], SMALL_DIGITS);
+			pos_ += small_lengths_[value];
+			return;
+		}
+		unsigned int rest = value;
+		if (value < 0) {
+			*pos_++ = '-';
+			rest = -rest;
+		}
+		char digits[MAX_INT_LENGTH];
+		int length = 0;
+		do {
+			digits[length++] = '0' + rest % 10;
+			rest /= 10;
+		} while (rest > 0);
+		while (length > 0)
+			*pos_++ = digits[--length];
+	}
+
+	inline void WriteChar(char c) {
+		if (pos_ == buffer_ + BUFFER_SIZE)
+			Flush();
+		*pos_++ = c;
+	}
+
+	void WriteString(const char* text) {
+		for (; *text != '\0'; ++text)
+			WriteChar(*text);
+	}
+
+	void Write(const std::string& text) {
+		if (pos_ + text.size() > buffer_ + BUFFER_SIZE)
+			Flush();
+		if (text.size() > (std::size_t)BUFFER_SIZE) {
+			WriteOut(text.data(), text.data() + text.size());
+			return;
+		}
+		std::memcpy(pos_, text.data(), text.size());
+		pos_ += text.size();
+	}
+
+	void Flush() {
+		WriteOut(buffer_, pos_);
+		pos_ = buffer_;
+	}
+
+private:
+	void WriteOut(const char* data, const char* end) {
+		if (capture_ != NULL) {
+			capture_->append(data, end);
+			return;
+		}
+		while (data < end) {
+			ssize_t count = write(1, data, end - data);
+			if (count <= 0)
+				break;
+			data += count;
+		}
+	}
+
+	static const int BUFFER_SIZE = 1 << 16;
+	static const int MAX_INT_LENGTH = 12;
+	static const int SMALL_INTS = 1000;
+	static const int SMALL_DIGITS = 4;
+
+// Data
+private:
+	char* pos_;
+	std::string* capture_;
+	char buffer_[BUFFER_SIZE];
+	char small_digits_[SMALL_INTS][SMALL_DIGITS];
+	char small_lengths_[SMALL_INTS];
+} output;
+
 struct Node {
 	int time;
+	int residue;
 	int line;
 	int column;
 };
@@ -39,9 +250,36 @@ struct Algorithm {
 	// Initialize
 	void init();
 
-	// Run algorithm
+	// Run algorithm with selected engine
 	void run();
 
+	// Queue BFS over (time, cell) states, reference engine
+	void runBfs();
+
+	// Bit-parallel BFS moving whole frontier per time step
+	void runFrontier();
+
+	// Frontier BFS without residue tables, for schedules of huge lcm
+	void runUnbounded();
+
+	// Builds period classes of cells and for queue BFS free cell masks
+	// of every time residue, unless they were built for the same grid
+	// and schedule
+	void updateMasks();
+
+	// Sets free_now_ to cells free at time 0
+	void resetFree();
+
+	// Moves free_now_ one time unit forward
+	void advanceFree();
+
+	// Moves every cell of frontier to itself and to its neighbours
+	void expandFrontier(const uint64_t* frontier, uint64_t* next);
+
+	// Records arrival time of pending targets in frontier, true when
+	// no target is pending anymore
+	bool settle(const uint64_t* frontier, int time);
+
 	// Check if move is valid
 	inline bool moveValid(Node& current, int direction[2]);
 
@@ -49,38 +287,135 @@ struct Algorithm {
 	void readInput();
 
 	// Print output to stdout
-	void printOutput();
+	void printOutput(OutputWriter& out);
 
 	const static char BLOCKED = '*';
 	const static char FREE = '.';
-	const static int GRID_SIZE = 25;
-	const static int TIME_SIZE = 9;
 
-	// Grid of graph nodes
-	char grid_[GRID_SIZE][GRID_SIZE];
+	// Largest residue table in words, free_ and visited_ each
+	const static int MAX_TABLE_WORDS = 1 << 23;
+
+	// Default latest time searched by runUnbounded
+	const static int DEFAULT_HORIZON = 1 << 16;
+
+	enum Engine { ENGINE_BFS, ENGINE_FRONTIER };
+
+	// Search engine used by run()
+	Engine engine_;
+
+	// Schedule rows are whitespace separated numbers, not digits
+	bool wide_schedule_;
+
+	// Each case lists its targets and gets map of arrival times
+	bool time_map_;
+
+	// Latest time searched when lcm_ is too large for residue tables
+	int horizon_;
+
+	// Grid of graph nodes, row major
+	vector<char> grid_;
 
-	// Schedule of work change
-	char schedule_[GRID_SIZE][GRID_SIZE];
+	// Schedule of work change, row major
+	vector<int> schedule_;
 
-	// Grid point at given time
-	//std::vector<bitset<25*25> > visited_;
-	vector<vector<char> > visited_;
-	vector<vector<char> > visit_count_;
+	// Row of digit schedule being read
+	vector<char> row_;
+
+	// Visited (time mod lcm_, grid point) states, packed bits of lcm_
+	// rows of words_ words, kept between test cases
+	vector<uint64_t> visited_;
 
 	// Size of grid and schedule
 	int grid_size_;
 
-	// Lowest commonon multiple
+	// Lowest commonon multiple of cell cycles, cell of period p repeats
+	// its state every 2p time units. Valid with use_tables_ only.
 	int lcm_;
 
+	// Residue tables fit in MAX_TABLE_WORDS
+	bool use_tables_;
+
+	inline int stateIndex(int residue, int line, int column) {
+		return (residue * words_ << 6) + line * grid_size_ + column;
+	}
+
+	// Free cell test of state, same layout as visited_
+	inline bool passable(int state) {
+		return (free_[state >> 6] >> (state & 63)) & 1;
+	}
+
+	inline bool visited(int state) {
+		return (visited_[state >> 6] >> (state & 63)) & 1;
+	}
+
+	inline void markVisited(int state) {
+		visited_[state >> 6] |= uint64_t(1) << (state & 63);
+	}
+
+	// Word of cell set, zero outside of set
+	inline uint64_t wordAt(const uint64_t* cells, int index) {
+		return (index >= 0 && index < words_) ? cells[index] : 0;
+	}
+
+	// 64 bits of cell set starting at bit start, which may be negative
+	inline uint64_t bitsAt(const uint64_t* cells, int start) {
+		int index = start >> 6;
+		int offset = start & 63;
+		uint64_t bits = wordAt(cells, index) >> offset;
+		if (offset)
+			bits |= wordAt(cells, index+1) << (64 - offset);
+		return bits;
+	}
+
 	// BFS queue
 	queue<Node> visit_queue_;
 
+	// Words of cell set of this grid, bit line * grid_size_ + column
+	int words_;
+
+	// Cells free at time residue r, words_ words per residue
+	vector<uint64_t> free_;
+
+	// Cells free at current time of search, and time since last state
+	// switch of each period class
+	vector<uint64_t> free_now_;
+	vector<int> phase_;
+
+	// Distinct periods of schedule, one class of cells each
+	vector<int> class_periods_;
+
+	// Cells of each class open in original and in switched state,
+	// words_ words each, class i at 2*i and 2*i+1
+	vector<uint64_t> class_masks_;
+
+	// Cells free in every time
+	vector<uint64_t> always_free_;
+
+	// Cells allowed after move left or right, without wrap to other line
+	vector<uint64_t> no_first_column_;
+	vector<uint64_t> no_last_column_;
+
+	// Frontier of search and its successor
+	vector<uint64_t> frontier_;
+	vector<uint64_t> next_;
+
+	// Grid and schedule masks were built for, reused by next case
+	// of the same maze
+	vector<char> masks_grid_;
+	vector<int> masks_schedule_;
+
 	// set of unique periods
 	set<int> periods_;
 
-	bool end_reached_;
-	int time_spent_;
+	// Cells to reach, all cells when empty in time map mode
+	vector<int> target_cells_;
+
+	// Targets not reached yet, and their count
+	vector<uint64_t> pending_;
+	int pending_count_;
+
+	// Earliest arrival time of each target, -1 if not reached
+	vector<int> arrival_;
 
 } algo;
 
@@ -88,23 +423,23 @@ void Algorithm::init() {
 	periods_.clear();
 	std::queue<Node> empty;
 	std::swap(visit_queue_, empty);
-	visited_.clear();
-	//visited_.resize(5040, bitset<25*25>(0) );
-	//visited_.resize(841, vector<char>(25*25, 0) );
-	visited_.resize(5040, vector<char>(25*25, 0) );
 
-	visit_count_.clear();
-	visit_count_.resize(26, vector<char>(26, 0) );
+	arrival_.assign(grid_size_ * grid_size_, -1);
+	words_ = (grid_size_ * grid_size_ + 63) / 64;
+	for (int cell = 0; cell < grid_size_ * grid_size_; ++cell) {
+		if (schedule_[cell] > 0)
+			periods_.insert(schedule_[cell]);
+	}
 
-	end_reached_ = false;
-	time_spent_ = 0;
-	for (int line = 0; line < grid_size_; ++line) {
-		for (int column = 0; column < grid_size_; ++column) {
-			if (schedule_[line][column] > 0)
-				periods_.insert(schedule_[line][column]);
-		}
+	// Stop as soon as residue tables would not fit
+	lcm_ = 1;
+	use_tables_ = true;
+	for (set<int>::iterator it = periods_.begin(); use_tables_ && it != periods_.end(); ++it) {
+		long long next = (long long)lcm_ / gcd(lcm_, 2 * *it) * (2 * *it);
+		use_tables_ = (next * words_ <= MAX_TABLE_WORDS);
+		if (use_tables_)
+			lcm_ = (int)next;
 	}
-	lcm_ = accumulate(periods_.begin(), periods_.end(), 1, lcm);
 }
 
 /**
@@ -112,12 +447,119 @@ void Algorithm::init() {
  */
 void Algorithm::run() {
 
-	if (grid_[grid_size_-1][grid_size_-1] == BLOCKED && schedule_[grid_size_-1][grid_size_-1] == 0)
+	// Targets blocked for ever are not reachable. Map still gives start
+	// arrival 0, single target keeps answer NO for such start.
+	pending_.assign(words_, 0);
+	pending_count_ = 0;
+	for (std::size_t i = 0; i < target_cells_.size(); ++i) {
+		int cell = target_cells_[i];
+		if (grid_[cell] == BLOCKED && schedule_[cell] == 0 && !(time_map_ && cell == 0))
+			continue;
+		if (!((pending_[cell >> 6] >> (cell & 63)) & 1))
+			++pending_count_;
+		pending_[cell >> 6] |= uint64_t(1) << (cell & 63);
+	}
+	if (pending_count_ == 0)
 		return;
 
+	updateMasks();
+	if (!use_tables_) {
+		runUnbounded();
+		return;
+	}
+
+	std::size_t table_words = (std::size_t)lcm_ * words_;
+	if (visited_.size() < table_words)
+		visited_.resize(table_words);
+
+	if (engine_ == ENGINE_BFS)
+		runBfs();
+	else
+		runFrontier();
+}
+
+/**
+ * Splits cells into classes of the same period, and for queue BFS
+ * builds free_ masks of every residue: cell of period p is in its
+ * original state when (r/p) is even
+ */
+void Algorithm::updateMasks() {
+	if (masks_grid_ == grid_ && masks_schedule_ == schedule_)
+		return;
+
+	const int cells = grid_size_ * grid_size_;
+	class_periods_.assign(periods_.begin(), periods_.end());
+	class_masks_.assign(2 * class_periods_.size() * words_, 0);
+	always_free_.assign(words_, 0);
+	no_first_column_.assign(words_, 0);
+	no_last_column_.assign(words_, 0);
+	for (int cell = 0; cell < cells; ++cell) {
+		uint64_t bit = uint64_t(1) << (cell & 63);
+		int period = schedule_[cell];
+		if (period == 0 && grid_[cell] == FREE) {
+			always_free_[cell >> 6] |= bit;
+		} else if (period > 0) {
+			int i = std::lower_bound(class_periods_.begin(), class_periods_.end(), period) - class_periods_.begin();
+			int state = (grid_[cell] == FREE) ? 0 : 1;
+			class_masks_[(2 * i + state) * words_ + (cell >> 6)] |= bit;
+		}
+		if (cell % grid_size_ != 0)
+			no_first_column_[cell >> 6] |= bit;
+		if (cell % grid_size_ != grid_size_-1)
+			no_last_column_[cell >> 6] |= bit;
+	}
+
+	masks_grid_ = grid_;
+	masks_schedule_ = schedule_;
+	if (!use_tables_ || engine_ != ENGINE_BFS)
+		return;
+
+	free_.resize((std::size_t)lcm_ * words_);
+	resetFree();
+	for (int residue = 0; residue < lcm_; ++residue) {
+		if (residue > 0)
+			advanceFree();
+		std::copy(free_now_.begin(), free_now_.end(), free_.begin() + (std::size_t)residue * words_);
+	}
+}
+
+/**
+ * Time 0 has every cell in original state
+ */
+void Algorithm::resetFree() {
+	const int classes = class_periods_.size();
+	phase_.assign(classes, 0);
+	free_now_ = always_free_;
+	for (int i = 0; i < classes; ++i) {
+		for (int w = 0; w < words_; ++w)
+			free_now_[w] |= class_masks_[2 * i * words_ + w];
+	}
+}
+
+/**
+ * Cells of period p flip at each multiple of p, phase counters track
+ * that without division
+ */
+void Algorithm::advanceFree() {
+	const int classes = class_periods_.size();
+	for (int i = 0; i < classes; ++i) {
+		if (++phase_[i] != class_periods_[i])
+			continue;
+		phase_[i] = 0;
+		const uint64_t* off = &class_masks_[2 * i * words_];
+		const uint64_t* on = off + words_;
+		for (int w = 0; w < words_; ++w)
+			free_now_[w] ^= on[w] ^ off[w];
+	}
+}
+
+void Algorithm::runBfs() {
+	std::fill(visited_.begin(), visited_.begin() + (std::size_t)lcm_ * words_, 0);
+
 	// Enqueue start node into queue
-	Node node = { 0, 0, 0 };
+	Node node = { 0, 0, 0, 0 };
 	visit_queue_.push(node);
+	markVisited(stateIndex(0, 0, 0));
 
 	
 	// Carry on as long as there are nodes to process
@@ -127,11 +569,13 @@ void Algorithm::run() {
 		node = visit_queue_.front();
 		visit_queue_.pop();
 		
-		// End of algorithm
-		if (node.line == grid_size_-1 && node.column == grid_size_-1) {
-			end_reached_ = true;
-			time_spent_ = node.time;
-			break;
+		// First visit of pending target is its earliest arrival
+		int cell = node.line * grid_size_ + node.column;
+		if ((pending_[cell >> 6] >> (cell & 63)) & 1) {
+			arrival_[cell] = node.time;
+			pending_[cell >> 6] &= ~(uint64_t(1) << (cell & 63));
+			if (--pending_count_ == 0)
+				break;
 		}
 		//std::cout << node.line << ", " << node.column << std::endl;
 		//if (node.line == 4 && node.column == 4)
@@ -139,7 +583,6 @@ void Algorithm::run() {
 
 		// Enqueue each possible move
 		int directions[5][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1}, {0, 0} };
-		const int wait_in_place = 4;
 		for (int move = 0; move < 5; ++move) {
 
 			// Check if move is valid
@@ -152,72 +595,206 @@ void Algorithm::run() {
 			next.line += directions[move][0];
 			next.column += directions[move][1];
 			next.time += 1;
-			if (visit_count_[next.line][next.column] > 10) {
-				continue;
-			}
-			visit_count_[next.line][next.column]++;
+			next.residue = (next.residue+1 == lcm_) ? 0 : next.residue+1;
 
 			// Enqueue and mark already as visited
 			visit_queue_.push(next);
-			
-			visited_[next.time][next.line*GRID_SIZE + next.column] = 1;
+			markVisited(stateIndex(next.residue, next.line, next.column));
 		}
 	}
 }
 
+/**
+ * Stay, up, down, left and right moves of whole frontier, as shifts
+ * by one line or one column. Bits past the last cell may be set,
+ * free cell masks clear them.
+ */
+void Algorithm::expandFrontier(const uint64_t* frontier, uint64_t* next) {
+	for (int w = 0; w < words_; ++w) {
+		int start = w << 6;
+		next[w] = frontier[w]
+			| bitsAt(frontier, start + grid_size_)
+			| bitsAt(frontier, start - grid_size_)
+			| (bitsAt(frontier, start + 1) & no_last_column_[w])
+			| (bitsAt(frontier, start - 1) & no_first_column_[w]);
+	}
+}
+
+bool Algorithm::settle(const uint64_t* frontier, int time) {
+	for (int w = 0; w < words_; ++w) {
+		uint64_t hits = frontier[w] & pending_[w];
+		if (!hits)
+			continue;
+		pending_[w] &= ~hits;
+		for (; hits; hits &= hits - 1) {
+			arrival_[(w << 6) + __builtin_ctzll(hits)] = time;
+			--pending_count_;
+		}
+	}
+	return pending_count_ == 0;
+}
+
+/**
+ * Same search as runBfs, but all states of one time step are moved at
+ * once as bitset: shifts by one line or one column give the moves, AND
+ * with free cells of next time filters them. Only states not seen
+ * before at the same residue form next frontier, so search ends on
+ * target or when whole (cell, time mod lcm_) space is exhausted.
+ * Rows of visited_ are cleared when search reaches them first, so
+ * short searches do not pay for whole lcm_ table.
+ */
+void Algorithm::runFrontier() {
+	resetFree();
+	frontier_.assign(words_, 0);
+	next_.resize(words_);
+	frontier_[0] = 1;
+	std::fill(visited_.begin(), visited_.begin() + words_, 0);
+	visited_[0] = 1;
+	int residue = 0;
+
+	// Frontier has some pending target
+	uint64_t hit = pending_[0] & 1;
+	for (int time = 0; ; ++time) {
+		if (hit && settle(&frontier_[0], time))
+			return;
+
+		expandFrontier(&frontier_[0], &next_[0]);
+		advanceFree();
+
+		residue = (residue+1 == lcm_) ? 0 : residue+1;
+		uint64_t* seen = &visited_[(std::size_t)residue * words_];
+		if (time + 1 < lcm_)
+			std::fill(seen, seen + words_, 0);
+		uint64_t any = 0;
+		hit = 0;
+		for (int w = 0; w < words_; ++w) {
+			next_[w] &= free_now_[w] & ~seen[w];
+			seen[w] |= next_[w];
+			any |= next_[w];
+			hit |= next_[w] & pending_[w];
+		}
+		if (!any)
+			return;
+		frontier_.swap(next_);
+	}
+}
+
+/**
+ * Earliest arrival search over (cell, time) states, when lcm_ is too
+ * large for residue tables. Unit moves make it BFS by time, so whole
+ * set of cells reachable at time t is moved at once, as in runFrontier.
+ * Free cells of time t follow from period classes and phase counters.
+ * Without residue table repeated states are not detected, so search
+ * ends on target, on empty frontier, or after horizon_ time units.
+ */
+void Algorithm::runUnbounded() {
+	resetFree();
+	frontier_.assign(words_, 0);
+	next_.resize(words_);
+	frontier_[0] = 1;
+
+	uint64_t hit = pending_[0] & 1;
+	for (int time = 0; time <= horizon_; ++time) {
+		if (hit && settle(&frontier_[0], time))
+			return;
+
+		expandFrontier(&frontier_[0], &next_[0]);
+		advanceFree();
+
+		uint64_t any = 0;
+		hit = 0;
+		for (int w = 0; w < words_; ++w) {
+			next_[w] &= free_now_[w];
+			any |= next_[w];
+			hit |= next_[w] & pending_[w];
+		}
+		if (!any)
+			return;
+		frontier_.swap(next_);
+	}
+}
+
 bool Algorithm::moveValid(Node& current, int direction[2]) {
 	int line = current.line + direction[0];
 	int column = current.column + direction[1];
-	int time = current.time + 1;
+	int residue = (current.residue+1 == lcm_) ? 0 : current.residue+1;
 
 	// Check if planed move is in bonds of grid
 	if (line < 0 || line >= grid_size_ || column < 0 || column >= grid_size_)
 		return false;
 	
-	// Check if it was already visited
-	if (visited_[time%lcm_][line*GRID_SIZE + column] ) {
-		return false;
-	}
-
-	// Check if planed node is free in time of this move
-	// time=<0, period> -> oryginal_state
-	// time=<period+1, period-1> ->  !oryginal_state
-
-	int period = schedule_[line][column];
-	bool state_switch = (period > 0) && ((time/period)%2);
-	
-	if (state_switch && grid_[line][column] == FREE)
-		return false;
-	if (!state_switch && grid_[line][column] == BLOCKED)
-		return false;
-	if (grid_[line][column] == BLOCKED && schedule_[line][column] == 0)
-		return false;
-
-
-	return true;
+	// Check if it was already visited, and if planed node is free in
+	// time of this move, see updateMasks
+	int state = stateIndex(residue, line, column);
+	return !visited(state) && passable(state);
 }
 
 /**
- * Read input
+ * Read input, schedule is row of digits per line, or with
+ * wide_schedule_ grid_size_ numbers per line. In time map mode
+ * schedule is followed by count of targets and their line and column,
+ * count 0 asks for all cells. Targets outside of grid are skipped.
  */
 void Algorithm::readInput() {
-	scanf("%d\n", &grid_size_);
+	grid_size_ = input.ReadInt();
+	const int cells = grid_size_ * grid_size_;
+	grid_.resize(cells + 1);
+	schedule_.resize(cells);
 	for (int i = 0; i < grid_size_; ++i) {
-		scanf("%s\n", grid_[i]);
+		input.ReadWord(&grid_[i * grid_size_]);
 	}
-	for (int i = 0; i < grid_size_; ++i) {
-		scanf("%s\n", schedule_[i]);
-		for (int j = 0; j < grid_size_; ++j) {
-			schedule_[i][j] -= '0';
+	if (wide_schedule_) {
+		for (int cell = 0; cell < cells; ++cell)
+			schedule_[cell] = input.ReadInt();
+	} else {
+		row_.resize(grid_size_ + 1);
+		for (int i = 0; i < grid_size_; ++i) {
+			input.ReadWord(&row_[0]);
+			for (int j = 0; j < grid_size_; ++j) {
+				schedule_[i * grid_size_ + j] = row_[j] - '0';
+			}
 		}
 	}
+
+	target_cells_.clear();
+	if (!time_map_) {
+		target_cells_.push_back(cells - 1);
+		return;
+	}
+	int count = input.ReadInt();
+	for (int i = 0; i < count; ++i) {
+		int line = input.ReadInt();
+		int column = input.ReadInt();
+		if (line < 0 || line >= grid_size_ || column < 0 || column >= grid_size_)
+			continue;
+		target_cells_.push_back(line * grid_size_ + column);
+	}
+	for (int cell = 0; count == 0 && cell < cells; ++cell)
+		target_cells_.push_back(cell);
 }
 
-void Algorithm::printOutput() {
-	if (end_reached_) 
-		printf("%d\n", time_spent_);
-	else
-		printf("NO\n");
+/**
+ * Prints arrival time at last cell, or in time map mode grid of
+ * arrival times, -1 where cell was not reached
+ */
+void Algorithm::printOutput(OutputWriter& out) {
+	if (!time_map_) {
+		if (arrival_.back() >= 0) {
+			out.WriteInt(arrival_.back());
+			out.WriteChar('\n');
+		} else {
+			out.WriteString("NO\n");
+		}
+		return;
+	}
+	for (int line = 0; line < grid_size_; ++line) {
+		for (int column = 0; column < grid_size_; ++column) {
+			if (column > 0)
+				out.WriteChar(' ');
+			out.WriteInt(arrival_[line * grid_size_ + column]);
+		}
+		out.WriteChar('\n');
+	}
 }
 
 /**
@@ -227,25 +804,304 @@ void run_testcase() {
 	algo.readInput();
 	algo.init();
 	algo.run();
-	algo.printOutput();
+	algo.printOutput(output);
 }
 
 /**
  * Main test loop
  */
 void run_test_loop() {
-	int test_cases = 1;
-	scanf("%d\n", &test_cases);
+	int test_cases = input.ReadInt();
 	while (test_cases--) {
 		run_testcase();
 	}
 }
 
 /**
- * Main entry point
+ * Solves every step-th case of batch starting from first,
+ * each into its own output
+ */
+void solve_cases(vector<Algorithm*>* cases, vector<std::string>* outputs, int count, int first, int step) {
+	for (int i = first; i < count; i += step) {
+		OutputWriter writer(&(*outputs)[i]);
+		(*cases)[i]->init();
+		(*cases)[i]->run();
+		(*cases)[i]->printOutput(writer);
+		writer.Flush();
+	}
+}
+
+/**
+ * Runs test cases in batches on workers_count threads, each worker with
+ * its own Algorithm states. Cases of batch are parsed in input order,
+ * solved in parallel, and printed in input order.
  */
-int main() {
-	run_test_loop();
+void run_tests_batch(int workers_count) {
+	const int CASES_PER_WORKER = 4;
+	const int batch_size = workers_count * CASES_PER_WORKER;
+	vector<Algorithm*> cases(batch_size);
+	vector<std::string> outputs(batch_size);
+	for (int i = 0; i < batch_size; ++i)
+		cases[i] = new Algorithm(algo);
+
+	int test_number = input.ReadInt();
+	while (test_number > 0) {
+		int count = std::min(test_number, batch_size);
+		test_number -= count;
+		for (int i = 0; i < count; ++i)
+			cases[i]->readInput();
+
+		vector<std::thread> workers;
+		for (int worker = 0; worker < workers_count; ++worker)
+			workers.push_back(std::thread(solve_cases, &cases, &outputs, count, worker, workers_count));
+		for (int worker = 0; worker < workers_count; ++worker)
+			workers[worker].join();
+
+		for (int i = 0; i < count; ++i) {
+			output.Write(outputs[i]);
+			outputs[i].clear();
+		}
+	}
+
+	for (int i = 0; i < batch_size; ++i)
+		delete cases[i];
+}
+
+/**
+ * Bounded lock-free queue of single producer and single consumer.
+ * Push and Pop spin a while when queue is full or empty, then sleep on
+ * condition variable until other side moves, so stage waiting for I/O
+ * does not keep its core busy. Other side takes the mutex only when
+ * somebody sleeps.
+ */
+template <typename T>
+class SpscQueue {
+public:
+	explicit SpscQueue(std::size_t capacity) : items_(capacity+1), head_(0), tail_(0), sleepers_(0) { }
+
+	bool TryPush(const T& item) {
+		std::size_t tail = tail_.load(std::memory_order_relaxed);
+		std::size_t next = (tail+1 == items_.size()) ? 0 : tail+1;
+		if (next == head_.load(std::memory_order_acquire))
+			return false;
+		items_[tail] = item;
+		tail_.store(next);
+		Wake();
+		return true;
+	}
+
+	bool TryPop(T& item) {
+		std::size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire))
+			return false;
+		item = items_[head];
+		head_.store((head+1 == items_.size()) ? 0 : head+1);
+		Wake();
+		return true;
+	}
+
+	void Push(const T& item) {
+		for (int spin = 0; !TryPush(item); ++spin) {
+			if (spin < SPIN_COUNT)
+				std::this_thread::yield();
+			else
+				Sleep(&SpscQueue::Full);
+		}
+	}
+
+	T Pop() {
+		T item;
+		for (int spin = 0; !TryPop(item); ++spin) {
+			if (spin < SPIN_COUNT)
+				std::this_thread::yield();
+			else
+				Sleep(&SpscQueue::Empty);
+		}
+		return item;
+	}
+
+private:
+	static const int SPIN_COUNT = 64;
+
+	bool Full() const {
+		std::size_t tail = tail_.load(std::memory_order_relaxed);
+		return ((tail+1 == items_.size()) ? 0 : tail+1) == head_.load();
+	}
+
+	bool Empty() const {
+		return head_.load(std::memory_order_relaxed) == tail_.load();
+	}
+
+	// Sleeper is counted before it checks the queue again, and the other
+	// side stores its index before it reads the count (both sequentially
+	// consistent), so either sleeper sees the change or it gets woken
+	void Sleep(bool (SpscQueue::*blocked)() const) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		sleepers_.fetch_add(1);
+		while ((this->*blocked)())
+			wakeup_.wait(lock);
+		sleepers_.fetch_sub(1);
+	}
+
+	void Wake() {
+		if (sleepers_.load() == 0)
+			return;
+		std::lock_guard<std::mutex> lock(mutex_);
+		wakeup_.notify_all();
+	}
+
+// Data
+private:
+	std::vector<T> items_;
+	std::atomic<std::size_t> head_;
+	std::atomic<std::size_t> tail_;
+	std::atomic<int> sleepers_;
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+};
+
+/**
+ * Streaming runner of test cases: this thread parses cases, workers solve
+ * them and writer thread prints them in input order, all at the same time.
+ * Case i goes to worker i % workers_count, so every queue has single
+ * producer and single consumer. Cases live in fixed number of slots
+ * returned by writer to parser, so memory stays bounded for any input.
+ * Case type provides Read() and Solve(OutputWriter&).
+ */
+template <typename Case>
+class Pipeline {
+public:
+	explicit Pipeline(int workers_count)
+		: workers_count_(workers_count), slots_count_(workers_count * SLOTS_PER_WORKER),
+		  free_slots_(slots_count_) {
+		for (int worker = 0; worker < workers_count_; ++worker) {
+			to_solve_.push_back(new SpscQueue<Slot*>(slots_count_));
+			to_write_.push_back(new SpscQueue<Slot*>(slots_count_));
+		}
+		for (int i = 0; i < slots_count_; ++i) {
+			slots_.push_back(new Slot());
+			free_slots_.Push(slots_.back());
+		}
+	}
+
+	~Pipeline() {
+		for (int worker = 0; worker < workers_count_; ++worker) {
+			delete to_solve_[worker];
+			delete to_write_[worker];
+		}
+		for (int i = 0; i < slots_count_; ++i)
+			delete slots_[i];
+	}
+
+	void Run(int test_number) {
+		std::vector<std::thread> threads;
+		for (int worker = 0; worker < workers_count_; ++worker) {
+			int cases_count = (test_number - worker + workers_count_ - 1) / workers_count_;
+			threads.push_back(std::thread(&Pipeline::Solve, this, worker, cases_count));
+		}
+		threads.push_back(std::thread(&Pipeline::Write, this, test_number));
+
+		for (int i = 0; i < test_number; ++i) {
+			Slot* slot = free_slots_.Pop();
+			slot->item.Read();
+			to_solve_[i % workers_count_]->Push(slot);
+		}
+
+		for (std::size_t i = 0; i < threads.size(); ++i)
+			threads[i].join();
+	}
+
+private:
+	static const int SLOTS_PER_WORKER = 4;
+
+	struct Slot {
+		Case item;
+		std::string output;
+	};
+
+	void Solve(int worker, int cases_count) {
+		while (cases_count--) {
+			Slot* slot = to_solve_[worker]->Pop();
+			{
+				OutputWriter writer(&slot->output);
+				slot->item.Solve(writer);
+			}
+			to_write_[worker]->Push(slot);
+		}
+	}
+
+	void Write(int test_number) {
+		for (int i = 0; i < test_number; ++i) {
+			Slot* slot = to_write_[i % workers_count_]->Pop();
+			output.Write(slot->output);
+			slot->output.clear();
+			free_slots_.Push(slot);
+		}
+	}
+
+// Data
+private:
+	int workers_count_;
+	int slots_count_;
+	std::vector<Slot*> slots_;
+	SpscQueue<Slot*> free_slots_;
+	std::vector<SpscQueue<Slot*>*> to_solve_;
+	std::vector<SpscQueue<Slot*>*> to_write_;
+};
+
+/**
+ * Test case of pipeline mode, own copy of Algorithm state
+ */
+struct PipelineCase {
+	Algorithm algo;
+	PipelineCase() : algo(::algo) { }
+	void Read() {
+		algo.readInput();
+	}
+	void Solve(OutputWriter& out) {
+		algo.init();
+		algo.run();
+		algo.printOutput(out);
+	}
+};
+
+/**
+ * Main entry point, "-j N" solves test cases on N threads,
+ * "-p N" streams them through pipeline with N solving threads,
+ * "bfs" selects queue BFS instead of bit-parallel frontier search,
+ * "wide" reads schedules as numbers separated by spaces, "-t T" sets
+ * latest time searched when periods are too many for residue tables,
+ * "map" reads targets of each case and prints their arrival times
+ */
+int main(int argc, char* argv[]) {
+	int workers_count = 1;
+	int pipeline_workers = 0;
+	algo.engine_ = Algorithm::ENGINE_FRONTIER;
+	algo.horizon_ = Algorithm::DEFAULT_HORIZON;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "bfs")
+			algo.engine_ = Algorithm::ENGINE_BFS;
+		else if (arg == "wide")
+			algo.wide_schedule_ = true;
+		else if (arg == "map")
+			algo.time_map_ = true;
+		else if (arg == "-t" && i+1 < argc)
+			algo.horizon_ = std::atoi(argv[++i]);
+		else if (arg == "-j" && i+1 < argc)
+			workers_count = std::atoi(argv[++i]);
+		else if (arg == "-p" && i+1 < argc)
+			pipeline_workers = std::atoi(argv[++i]);
+	}
+
+	if (pipeline_workers > 0) {
+		Pipeline<PipelineCase> pipeline(pipeline_workers);
+		pipeline.Run(input.ReadInt());
+	} else if (workers_count > 1) {
+		run_tests_batch(workers_count);
+	} else {
+		run_test_loop();
+	}
 	return 0;
 }
 
@@ -1,22 +1,359 @@
 #include <cstdio>
 #include <utility>
 #include <queue>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <vector>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#define BITMAP_X86
+#include <immintrin.h>
+#endif
 
 using std::queue;
 using std::pair;
 using std::make_pair;
+using std::vector;
 typedef pair<unsigned int, unsigned int> position_t;
 
+/**
+ * Bulk reader of stdin. Regular file is mapped into memory at once,
+ * pipe is read in large blocks. Numbers and words are parsed straight
+ * from the buffer, no library call per token.
+ */
+class InputReader {
+public:
+    InputReader() : pos_(NULL), end_(NULL), mapped_(NULL), mapped_size_(0) {
+        struct stat info;
+        off_t offset = lseek(0, 0, SEEK_CUR);
+        if (fstat(0, &info) == 0 && S_ISREG(info.st_mode) && offset >= 0 && info.st_size > offset) {
+            void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, 0, 0);
+            if (data != MAP_FAILED) {
+                mapped_ = static_cast<char*>(data);
+                mapped_size_ = info.st_size;
+                pos_ = mapped_ + offset;
+                end_ = mapped_ + mapped_size_;
+            }
+        }
+    }
+
+    ~InputReader() {
+        if (mapped_ != NULL)
+            munmap(mapped_, mapped_size_);
+    }
+
+    /**
+     * Reads signed decimal number, like scanf("%d")
+     */
+    int ReadInt() {
+        SkipSpaces();
+        bool negative = false;
+        if (Peek() == '-' || Peek() == '+') {
+            negative = (*pos_ == '-');
+            ++pos_;
+        }
+        int value = 0;
+        for (int c = Peek(); c >= '0' && c <= '9'; c = Peek()) {
+            value = value * 10 + (c - '0');
+            ++pos_;
+        }
+        return negative ? -value : value;
+    }
+
+    /**
+     * Reads word into buffer, like scanf("%s"), returns its length
+     */
+    std::size_t ReadWord(char* word) {
+        SkipSpaces();
+        std::size_t length = 0;
+        for (int c = Peek(); c != EOF && c > ' '; c = Peek()) {
+            // Copy whole run of non space characters available in buffer
+            const char* run = pos_;
+            while (run != end_ && static_cast<unsigned char>(*run) > ' ')
+                ++run;
+            std::memcpy(word + length, pos_, run - pos_);
+            length += run - pos_;
+            pos_ = run;
+        }
+        word[length] = '\0';
+        return length;
+    }
+
+private:
+    static const std::size_t BLOCK_SIZE = 1 << 16;
+
+    inline int Peek() {
+        if (pos_ == end_ && !Refill())
+            return EOF;
+        return static_cast<unsigned char>(*pos_);
+    }
+
+    inline void SkipSpaces() {
+        for (int c = Peek(); c != EOF && c <= ' '; c = Peek())
+            ++pos_;
+    }
+
+    bool Refill() {
+        if (mapped_ != NULL)
+            return false;
+        ssize_t count = read(0, block_, BLOCK_SIZE);
+        if (count <= 0)
+            return false;
+        pos_ = block_;
+        end_ = block_ + count;
+        return true;
+    }
+
+// Data
+private:
+    const char* pos_;
+    const char* end_;
+    char* mapped_;
+    std::size_t mapped_size_;
+    char block_[BLOCK_SIZE];
+} input;
+
+/**
+ * Bulk writer to stdout. Output is formatted into large buffer and
+ * written out only when buffer fills up and at exit. Small numbers
+ * are copied from precomputed table of their digits. Writer given
+ * a string collects output there instead, to be written later.
+ */
+class OutputWriter {
+public:
+    explicit OutputWriter(std::string* capture = NULL) : pos_(buffer_), capture_(capture) {
+        for (int value = 0; value < SMALL_INTS; ++value) {
+            int length = 0;
+            for (int rest = value; rest > 0 || length == 0; rest /= 10)
+                ++length;
+            small_lengths_[value] = length;
+            for (int i = length-1, rest = value; i >= 0; --i, rest /= 10)
+                small_digits_[value][i] = '0' + rest % 10;
+        }
+    }
+
+    ~OutputWriter() {
+        Flush();
+    }
+
+    inline void WriteInt(int value) {
+        if (pos_ + MAX_INT_LENGTH > buffer_ + BUFFER_SIZE)
+            Flush();
+        if (value >= 0 && value < SMALL_INTS) {
+            std::memcpy(pos_, small_digits_[value], SMALL_DIGITS);
+            pos_ += small_lengths_[value];
+            return;
+        }
+        unsigned int rest = value;
+        if (value < 0) {
+            *pos_++ = '-';
+            rest = -rest;
+        }
+        char digits[MAX_INT_LENGTH];
+        int length = 0;
+        do {
+            digits[length++] = '0' + rest % 10;
+            rest /= 10;
+        } while (rest > 0);
+        while (length > 0)
+            *pos_++ = digits[--length];
+    }
+
+    inline void WriteChar(char c) {
+        if (pos_ == buffer_ + BUFFER_SIZE)
+            Flush();
+        *pos_++ = c;
+    }
+
+    void WriteString(const char* text) {
+        for (; *text != '\0'; ++text)
+            WriteChar(*text);
+    }
+
+    void Write(const std::string& text) {
+        if (pos_ + text.size() > buffer_ + BUFFER_SIZE)
+            Flush();
+        if (text.size() > (std::size_t)BUFFER_SIZE) {
+            WriteOut(text.data(), text.data() + text.size());
+            return;
+        }
+        std::memcpy(pos_, text.data(), text.size());
+        pos_ += text.size();
+    }
+
+    void Flush() {
+        WriteOut(buffer_, pos_);
+        pos_ = buffer_;
+    }
+
+private:
+    void WriteOut(const char* data, const char* end) {
+        if (capture_ != NULL) {
+            capture_->append(data, end);
+            return;
+        }
+        while (data < end) {
+            ssize_t count = write(1, data, end - data);
+            if (count <= 0)
+                break;
+            data += count;
+        }
+    }
+
+    static const int BUFFER_SIZE = 1 << 16;
+    static const int MAX_INT_LENGTH = 12;
+    static const int SMALL_INTS = 1000;
+    static const int SMALL_DIGITS = 4;
+
+// Data
+private:
+    char* pos_;
+    std::string* capture_;
+    char buffer_[BUFFER_SIZE];
+    char small_digits_[SMALL_INTS][SMALL_DIGITS];
+    char small_lengths_[SMALL_INTS];
+} output;
+
+/**
+ * Vertical step of distance sweep: row[i] = min(row[i], neighbour[i]+1)
+ * for count cells, count is multiple of 32. Unreached cells hold the
+ * largest value of distance type, adding one to it must not wrap.
+ */
+template <typename T>
+struct Relax {
+    typedef void (*row_t)(T* row, const T* neighbour, int count);
+};
+
+template <typename T>
+void relaxRowScalar(T* row, const T* neighbour, int count) {
+    for (int i = 0; i < count; ++i)
+        if (neighbour[i]+1 < row[i])
+            row[i] = neighbour[i]+1;
+}
+
+#ifdef BITMAP_X86
+void relaxRowSse2(uint8_t* row, const uint8_t* neighbour, int count) {
+    const __m128i one = _mm_set1_epi8(1);
+    for (int i = 0; i < count; i += 16) {
+        __m128i up = _mm_adds_epu8(_mm_loadu_si128((const __m128i*)(neighbour + i)), one);
+        __m128i cell = _mm_loadu_si128((const __m128i*)(row + i));
+        _mm_storeu_si128((__m128i*)(row + i), _mm_min_epu8(cell, up));
+    }
+}
+
+void relaxRowSse2(uint16_t* row, const uint16_t* neighbour, int count) {
+    const __m128i one = _mm_set1_epi16(1);
+    for (int i = 0; i < count; i += 8) {
+        __m128i up = _mm_adds_epu16(_mm_loadu_si128((const __m128i*)(neighbour + i)), one);
+        __m128i cell = _mm_loadu_si128((const __m128i*)(row + i));
+        // No unsigned 16 bit min in SSE2: min(a, b) = a - saturated(a - b)
+        _mm_storeu_si128((__m128i*)(row + i), _mm_sub_epi16(cell, _mm_subs_epu16(cell, up)));
+    }
+}
+
+__attribute__((target("sse4.1")))
+void relaxRowSse41(uint32_t* row, const uint32_t* neighbour, int count) {
+    const __m128i one = _mm_set1_epi32(1);
+    for (int i = 0; i < count; i += 4) {
+        __m128i up = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(neighbour + i)), one);
+        __m128i cell = _mm_loadu_si128((const __m128i*)(row + i));
+        _mm_storeu_si128((__m128i*)(row + i), _mm_min_epu32(cell, up));
+    }
+}
+
+__attribute__((target("avx2")))
+void relaxRowAvx2(uint8_t* row, const uint8_t* neighbour, int count) {
+    const __m256i one = _mm256_set1_epi8(1);
+    for (int i = 0; i < count; i += 32) {
+        __m256i up = _mm256_adds_epu8(_mm256_loadu_si256((const __m256i*)(neighbour + i)), one);
+        __m256i cell = _mm256_loadu_si256((const __m256i*)(row + i));
+        _mm256_storeu_si256((__m256i*)(row + i), _mm256_min_epu8(cell, up));
+    }
+}
+
+__attribute__((target("avx2")))
+void relaxRowAvx2(uint16_t* row, const uint16_t* neighbour, int count) {
+    const __m256i one = _mm256_set1_epi16(1);
+    for (int i = 0; i < count; i += 16) {
+        __m256i up = _mm256_adds_epu16(_mm256_loadu_si256((const __m256i*)(neighbour + i)), one);
+        __m256i cell = _mm256_loadu_si256((const __m256i*)(row + i));
+        _mm256_storeu_si256((__m256i*)(row + i), _mm256_min_epu16(cell, up));
+    }
+}
+
+__attribute__((target("avx2")))
+void relaxRowAvx2(uint32_t* row, const uint32_t* neighbour, int count) {
+    const __m256i one = _mm256_set1_epi32(1);
+    for (int i = 0; i < count; i += 8) {
+        __m256i up = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(neighbour + i)), one);
+        __m256i cell = _mm256_loadu_si256((const __m256i*)(row + i));
+        _mm256_storeu_si256((__m256i*)(row + i), _mm256_min_epu32(cell, up));
+    }
+}
+#endif
+
+/**
+ * Vector kernels for every distance type, the widest supported by CPU
+ */
+struct RelaxKernels {
+    Relax<uint8_t>::row_t row8;
+    Relax<uint16_t>::row_t row16;
+    Relax<uint32_t>::row_t row32;
+
+    RelaxKernels() {
+        row8 = relaxRowScalar<uint8_t>;
+        row16 = relaxRowScalar<uint16_t>;
+        row32 = relaxRowScalar<uint32_t>;
+#ifdef BITMAP_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            row8 = relaxRowAvx2;
+            row16 = relaxRowAvx2;
+            row32 = relaxRowAvx2;
+            return;
+        }
+        row8 = relaxRowSse2;
+        row16 = relaxRowSse2;
+        if (__builtin_cpu_supports("sse4.1"))
+            row32 = relaxRowSse41;
+#endif
+    }
+
+    inline void relax(uint8_t* row, const uint8_t* neighbour, int count) { row8(row, neighbour, count); }
+    inline void relax(uint16_t* row, const uint16_t* neighbour, int count) { row16(row, neighbour, count); }
+    inline void relax(uint32_t* row, const uint32_t* neighbour, int count) { row32(row, neighbour, count); }
+};
+
+/**
+ * Marker of unreached cell for each distance type
+ */
+template <typename T> struct Unreached { static const T value; };
+template <> const uint8_t Unreached<uint8_t>::value = 0xFF;
+template <> const uint16_t Unreached<uint16_t>::value = 0xFFFF;
+template <> const uint32_t Unreached<uint32_t>::value = 0x7FFFFFFF;
+
 // See http://www.spoj.com/problems/BITMAP/
 class Algorithm {
-    // Node bitmap
-    char bitmap_[182][182];
-
-    // Visited nodes
-    // bool visited_[182][182];
+    // Node bitmap, row per line with room for word terminator
+    vector<char> bitmap_;
 
-    // Current known distance to white node
-    int distance_[182][182];
+    // Current known distance to white node, in storage of the narrowest
+    // type holding lines+columns, rows padded to whole vectors. Every type
+    // has own vector, so rows are never accessed through other type.
+    vector<uint8_t> distances8_;
+    vector<uint16_t> distances16_;
+    vector<uint32_t> distances32_;
+    int distance_bytes_;
+    int pitch_;
 
     // Number of lines
     int lines_count_;
@@ -26,28 +363,92 @@ class Algorithm {
     // FIFO queue of nodes for BFS
     queue<position_t> node_queue_;
 
+    RelaxKernels kernels_;
+
     const static char WHITE = 1;
+    const static int UNREACHED = 5000;
+
+    inline char* bitmapLine(int line) {
+        return &bitmap_[(std::size_t)line * (columns_count_+1)];
+    }
+
+    inline vector<uint8_t>& distanceStorage(uint8_t*) { return distances8_; }
+    inline vector<uint16_t>& distanceStorage(uint16_t*) { return distances16_; }
+    inline vector<uint32_t>& distanceStorage(uint32_t*) { return distances32_; }
+
+    template <typename T>
+    inline T* distanceLine(int line) {
+        return &distanceStorage((T*)NULL)[0] + (std::size_t)line * pitch_;
+    }
+
+    template <typename T> void runTyped();
+    template <typename T> void runBfs();
+    template <typename T> void runSweep();
+    template <typename T> void runParallelSweep();
+    template <typename T> void sweepColumns(int first_column, int last_column);
+    template <typename T> void sweepLines(int first_line, int last_line);
+    template <typename T> void printTyped(OutputWriter& out);
+
+    // Images smaller than that are swept by single thread
+    const static std::size_t PARALLEL_CELLS = 1 << 18;
 
 public:
+    enum Engine { BFS, SWEEP };
+
+    Algorithm() : engine_(SWEEP), threads_count_(1) { }
+    void setEngine(Engine engine) { engine_ = engine; }
+    void setThreadsCount(int threads_count) { threads_count_ = threads_count; }
     void readInput();
     void run();
-    void printOutput();
+    void printOutput(OutputWriter& out);
+
+private:
+    Engine engine_;
+    int threads_count_;
 } algo;
 
 /**
- * Runs the algorithm - based on BFS
+ * Picks distance type by image size and runs the selected engine
  */
 void Algorithm::run() {
+    int max_distance = lines_count_ + columns_count_;
+    if (max_distance < Unreached<uint8_t>::value)
+        runTyped<uint8_t>();
+    else if (max_distance < Unreached<uint16_t>::value)
+        runTyped<uint16_t>();
+    else
+        runTyped<uint32_t>();
+}
+
+template <typename T>
+void Algorithm::runTyped() {
+    distance_bytes_ = sizeof(T);
+    pitch_ = (columns_count_ + 31) / 32 * 32;
+    std::size_t cells = (std::size_t)lines_count_ * pitch_;
+    distanceStorage((T*)NULL).resize(cells);
+    if (engine_ == BFS)
+        runBfs<T>();
+    else if (threads_count_ > 1 && cells >= PARALLEL_CELLS)
+        runParallelSweep<T>();
+    else
+        runSweep<T>();
+}
+
+/**
+ * Runs the algorithm - based on BFS, reference engine
+ */
+template <typename T>
+void Algorithm::runBfs() {
 
     // Find all white nodes and add them to priority queue as starting points
-    // Also resets visited and distance arrays
+    // Also resets distance array
     for (int line = 0; line < lines_count_; ++line) {
+        T* distance = distanceLine<T>(line);
         for (int column = 0; column < columns_count_; ++column) {
-            //visited_[line][column] = false;
-            distance_[line][column] = 5000;
-            if (bitmap_[line][column] == WHITE) {
+            distance[column] = Unreached<T>::value;
+            if (bitmapLine(line)[column] == WHITE) {
                 node_queue_.push( position_t(line, column) );
-                distance_[line][column] = 0;
+                distance[column] = 0;
             }
         }
     }
@@ -58,6 +459,7 @@ void Algorithm::run() {
         // Pop the first node
         position_t node  = node_queue_.front();
         node_queue_.pop();
+        T next_distance = distanceLine<T>(node.first)[node.second] + 1;
 
         // And try to move in every possible direction from this node
         int directions[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
@@ -70,36 +472,160 @@ void Algorithm::run() {
                 continue;
 
             // Check if that direction is better that currently known
-            if (distance_[line][column] <= distance_[node.first][node.second]+1)
+            T& distance = distanceLine<T>(line)[column];
+            if (distance <= next_distance)
                 continue;
 
             // Set new distance and add to queue
-            distance_[line][column] = distance_[node.first][node.second]+1;            
+            distance = next_distance;
             node_queue_.push(position_t(line, column));
         }
     }
 }
 
+/**
+ * Runs the algorithm - two pass raster sweep. Distance to white node in
+ * L1 metric splits into vertical and horizontal part: vertical steps are
+ * vectorized across columns, horizontal steps are scanned along the row.
+ * Forward pass brings distances from above and left, backward pass from
+ * below and right.
+ */
+template <typename T>
+void Algorithm::runSweep() {
+    for (int line = 0; line < lines_count_; ++line) {
+        T* row = distanceLine<T>(line);
+        const char* pixels = bitmapLine(line);
+        for (int column = 0; column < columns_count_; ++column)
+            row[column] = (pixels[column] == WHITE) ? 0 : Unreached<T>::value;
+        for (int column = columns_count_; column < pitch_; ++column)
+            row[column] = Unreached<T>::value;
+    }
+
+    // Forward pass, top to bottom and left to right
+    for (int line = 0; line < lines_count_; ++line) {
+        T* row = distanceLine<T>(line);
+        if (line > 0)
+            kernels_.relax(row, distanceLine<T>(line-1), pitch_);
+        for (int column = 1; column < columns_count_; ++column)
+            if (row[column-1]+1 < row[column])
+                row[column] = row[column-1]+1;
+    }
+
+    // Backward pass, bottom to top and right to left
+    for (int line = lines_count_-1; line >= 0; --line) {
+        T* row = distanceLine<T>(line);
+        if (line < lines_count_-1)
+            kernels_.relax(row, distanceLine<T>(line+1), pitch_);
+        for (int column = columns_count_-2; column >= 0; --column)
+            if (row[column+1]+1 < row[column])
+                row[column] = row[column+1]+1;
+    }
+}
+
+/**
+ * Runs the algorithm - separable sweep on many threads. L1 distance is
+ * min over columns k of (vertical distance in column k + |column - k|),
+ * so the image is first swept down and up by bands of columns, and then
+ * every line is swept left and right by bands of lines. Bands do not
+ * share cells, so result is exactly the same as of single thread sweep.
+ */
+template <typename T>
+void Algorithm::runParallelSweep() {
+    vector<std::thread> workers;
+
+    // Vertical distances, bands of whole vectors of columns
+    int vectors_count = pitch_ / 32;
+    for (int worker = 0; worker < threads_count_; ++worker) {
+        int first_column = vectors_count * worker / threads_count_ * 32;
+        int last_column = vectors_count * (worker+1) / threads_count_ * 32;
+        if (first_column < last_column)
+            workers.push_back(std::thread(&Algorithm::sweepColumns<T>, this, first_column, last_column));
+    }
+    for (std::size_t worker = 0; worker < workers.size(); ++worker)
+        workers[worker].join();
+    workers.clear();
+
+    // Horizontal distances, bands of lines
+    for (int worker = 0; worker < threads_count_; ++worker) {
+        int first_line = lines_count_ * worker / threads_count_;
+        int last_line = lines_count_ * (worker+1) / threads_count_;
+        if (first_line < last_line)
+            workers.push_back(std::thread(&Algorithm::sweepLines<T>, this, first_line, last_line));
+    }
+    for (std::size_t worker = 0; worker < workers.size(); ++worker)
+        workers[worker].join();
+}
+
+/**
+ * Distance to nearest white node in the same column, for band of columns
+ */
+template <typename T>
+void Algorithm::sweepColumns(int first_column, int last_column) {
+    int width = last_column - first_column;
+    for (int line = 0; line < lines_count_; ++line) {
+        T* row = distanceLine<T>(line);
+        const char* pixels = bitmapLine(line);
+        for (int column = first_column; column < last_column; ++column)
+            row[column] = (column < columns_count_ && pixels[column] == WHITE) ? 0 : Unreached<T>::value;
+        if (line > 0)
+            kernels_.relax(row + first_column, distanceLine<T>(line-1) + first_column, width);
+    }
+    for (int line = lines_count_-2; line >= 0; --line)
+        kernels_.relax(distanceLine<T>(line) + first_column, distanceLine<T>(line+1) + first_column, width);
+}
+
+/**
+ * Horizontal part of distance along every line of band
+ */
+template <typename T>
+void Algorithm::sweepLines(int first_line, int last_line) {
+    for (int line = first_line; line < last_line; ++line) {
+        T* row = distanceLine<T>(line);
+        for (int column = 1; column < columns_count_; ++column)
+            if (row[column-1]+1 < row[column])
+                row[column] = row[column-1]+1;
+        for (int column = columns_count_-2; column >= 0; --column)
+            if (row[column+1]+1 < row[column])
+                row[column] = row[column+1]+1;
+    }
+}
+
 /**
  * Parse input into Algorithm
  */
 void Algorithm::readInput() {
-    scanf("%u %u", &lines_count_, &columns_count_);
+    lines_count_ = input.ReadInt();
+    columns_count_ = input.ReadInt();
+    bitmap_.resize((std::size_t)lines_count_ * (columns_count_+1));
     for (int line = 0; line < lines_count_; ++line) {
-        scanf("%s", bitmap_[line]);
+        char* pixels = bitmapLine(line);
+        input.ReadWord(pixels);
         for (int column = 0; column < columns_count_; ++column)
-            bitmap_[line][column] -= '0';
+            pixels[column] -= '0';
     }
 }
 
 /**
  * Prints the output
  */
-void Algorithm::printOutput() {
+void Algorithm::printOutput(OutputWriter& out) {
+    if (distance_bytes_ == sizeof(uint8_t))
+        printTyped<uint8_t>(out);
+    else if (distance_bytes_ == sizeof(uint16_t))
+        printTyped<uint16_t>(out);
+    else
+        printTyped<uint32_t>(out);
+}
+
+template <typename T>
+void Algorithm::printTyped(OutputWriter& out) {
     for (int line = 0; line < lines_count_; ++line) {
-        for (int column = 0; column < columns_count_; ++column)
-            printf("%d ", distance_[line][column]);
-        printf("\n");
+        const T* distance = distanceLine<T>(line);
+        for (int column = 0; column < columns_count_; ++column) {
+            out.WriteInt(distance[column] == Unreached<T>::value ? UNREACHED : distance[column]);
+            out.WriteChar(' ');
+        }
+        out.WriteChar('\n');
     }
 }
 
@@ -108,19 +634,287 @@ void Algorithm::printOutput() {
  * Main loop
  */
 void run_tests_loop() {
-    int test_number = 0;
-    scanf("%d", &test_number);
+    int test_number = input.ReadInt();
     while (test_number--) {
 		algo.readInput();
 		algo.run();
-		algo.printOutput();
+		algo.printOutput(output);
+    }
+}
+
+/**
+ * Solves every step-th case of batch starting from first,
+ * each into its own output
+ */
+void solve_cases(vector<Algorithm*>* cases, vector<std::string>* outputs, int count, int first, int step) {
+    for (int i = first; i < count; i += step) {
+        OutputWriter writer(&(*outputs)[i]);
+        (*cases)[i]->run();
+        (*cases)[i]->printOutput(writer);
+        writer.Flush();
+    }
+}
+
+/**
+ * Runs test cases in batches on workers_count threads, each worker with
+ * its own Algorithm states. Cases of batch are parsed in input order,
+ * solved in parallel, and printed in input order.
+ */
+void run_tests_batch(int workers_count) {
+    const int CASES_PER_WORKER = 4;
+    const int batch_size = workers_count * CASES_PER_WORKER;
+    vector<Algorithm*> cases(batch_size);
+    vector<std::string> outputs(batch_size);
+    for (int i = 0; i < batch_size; ++i)
+        cases[i] = new Algorithm(algo);
+
+    int test_number = input.ReadInt();
+    while (test_number > 0) {
+        int count = std::min(test_number, batch_size);
+        test_number -= count;
+        for (int i = 0; i < count; ++i)
+            cases[i]->readInput();
+
+        vector<std::thread> workers;
+        for (int worker = 0; worker < workers_count; ++worker)
+            workers.push_back(std::thread(solve_cases, &cases, &outputs, count, worker, workers_count));
+        for (int worker = 0; worker < workers_count; ++worker)
+            workers[worker].join();
+
+        for (int i = 0; i < count; ++i) {
+            output.Write(outputs[i]);
+            outputs[i].clear();
+        }
     }
+
+    for (int i = 0; i < batch_size; ++i)
+        delete cases[i];
 }
 
+
 /**
- * Main entry point
+ * Bounded lock-free queue of single producer and single consumer.
+ * Push and Pop spin a while when queue is full or empty, then sleep on
+ * condition variable until other side moves, so stage waiting for I/O
+ * does not keep its core busy. Other side takes the mutex only when
+ * somebody sleeps.
  */
-int main() {
-    run_tests_loop();
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity) : items_(capacity+1), head_(0), tail_(0), sleepers_(0) { }
+
+    bool TryPush(const T& item) {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        std::size_t next = (tail+1 == items_.size()) ? 0 : tail+1;
+        if (next == head_.load(std::memory_order_acquire))
+            return false;
+        items_[tail] = item;
+        tail_.store(next);
+        Wake();
+        return true;
+    }
+
+    bool TryPop(T& item) {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = items_[head];
+        head_.store((head+1 == items_.size()) ? 0 : head+1);
+        Wake();
+        return true;
+    }
+
+    void Push(const T& item) {
+        for (int spin = 0; !TryPush(item); ++spin) {
+            if (spin < SPIN_COUNT)
+                std::this_thread::yield();
+            else
+                Sleep(&SpscQueue::Full);
+        }
+    }
+
+    T Pop() {
+        T item;
+        for (int spin = 0; !TryPop(item); ++spin) {
+            if (spin < SPIN_COUNT)
+                std::this_thread::yield();
+            else
+                Sleep(&SpscQueue::Empty);
+        }
+        return item;
+    }
+
+private:
+    static const int SPIN_COUNT = 64;
+
+    bool Full() const {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        return ((tail+1 == items_.size()) ? 0 : tail+1) == head_.load();
+    }
+
+    bool Empty() const {
+        return head_.load(std::memory_order_relaxed) == tail_.load();
+    }
+
+    // Sleeper is counted before it checks the queue again, and the other
+    // side stores its index before it reads the count (both sequentially
+    // consistent), so either sleeper sees the change or it gets woken
+    void Sleep(bool (SpscQueue::*blocked)() const) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        while ((this->*blocked)())
+            wakeup_.wait(lock);
+        sleepers_.fetch_sub(1);
+    }
+
+    void Wake() {
+        if (sleepers_.load() == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        wakeup_.notify_all();
+    }
+
+// Data
+private:
+    std::vector<T> items_;
+    std::atomic<std::size_t> head_;
+    std::atomic<std::size_t> tail_;
+    std::atomic<int> sleepers_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+};
+
+/**
+ * Streaming runner of test cases: this thread parses cases, workers solve
+ * them and writer thread prints them in input order, all at the same time.
+ * Case i goes to worker i % workers_count, so every queue has single
+ * producer and single consumer. Cases live in fixed number of slots
+ * returned by writer to parser, so memory stays bounded for any input.
+ * Case type provides Read() and Solve(OutputWriter&).
+ */
+template <typename Case>
+class Pipeline {
+public:
+    explicit Pipeline(int workers_count)
+        : workers_count_(workers_count), slots_count_(workers_count * SLOTS_PER_WORKER),
+          free_slots_(slots_count_) {
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            to_solve_.push_back(new SpscQueue<Slot*>(slots_count_));
+            to_write_.push_back(new SpscQueue<Slot*>(slots_count_));
+        }
+        for (int i = 0; i < slots_count_; ++i) {
+            slots_.push_back(new Slot());
+            free_slots_.Push(slots_.back());
+        }
+    }
+
+    ~Pipeline() {
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            delete to_solve_[worker];
+            delete to_write_[worker];
+        }
+        for (int i = 0; i < slots_count_; ++i)
+            delete slots_[i];
+    }
+
+    void Run(int test_number) {
+        std::vector<std::thread> threads;
+        for (int worker = 0; worker < workers_count_; ++worker) {
+            int cases_count = (test_number - worker + workers_count_ - 1) / workers_count_;
+            threads.push_back(std::thread(&Pipeline::Solve, this, worker, cases_count));
+        }
+        threads.push_back(std::thread(&Pipeline::Write, this, test_number));
+
+        for (int i = 0; i < test_number; ++i) {
+            Slot* slot = free_slots_.Pop();
+            slot->item.Read();
+            to_solve_[i % workers_count_]->Push(slot);
+        }
+
+        for (std::size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+    }
+
+private:
+    static const int SLOTS_PER_WORKER = 4;
+
+    struct Slot {
+        Case item;
+        std::string output;
+    };
+
+    void Solve(int worker, int cases_count) {
+        while (cases_count--) {
+            Slot* slot = to_solve_[worker]->Pop();
+            {
+                OutputWriter writer(&slot->output);
+                slot->item.Solve(writer);
+            }
+            to_write_[worker]->Push(slot);
+        }
+    }
+
+    void Write(int test_number) {
+        for (int i = 0; i < test_number; ++i) {
+            Slot* slot = to_write_[i % workers_count_]->Pop();
+            output.Write(slot->output);
+            slot->output.clear();
+            free_slots_.Push(slot);
+        }
+    }
+
+// Data
+private:
+    int workers_count_;
+    int slots_count_;
+    std::vector<Slot*> slots_;
+    SpscQueue<Slot*> free_slots_;
+    std::vector<SpscQueue<Slot*>*> to_solve_;
+    std::vector<SpscQueue<Slot*>*> to_write_;
+};
+
+/**
+ * Test case of pipeline mode, own copy of Algorithm state
+ */
+struct PipelineCase {
+    Algorithm algo;
+    PipelineCase() : algo(::algo) { }
+    void Read() {
+        algo.readInput();
+    }
+    void Solve(OutputWriter& out) {
+        algo.run();
+        algo.printOutput(out);
+    }
+};
+
+/**
+ * Main entry point, "bfs" argument selects the reference engine,
+ * number argument sets threads count of the sweep engine,
+ * "-j N" solves test cases on N threads, "-p N" streams them through
+ * pipeline with N solving threads
+ */
+int main(int argc, char* argv[]) {
+    int workers_count = 1;
+    int pipeline_workers = 0;
+    for (int arg = 1; arg < argc; ++arg) {
+        if (std::strcmp(argv[arg], "bfs") == 0)
+            algo.setEngine(Algorithm::BFS);
+        else if (std::strcmp(argv[arg], "-j") == 0 && arg+1 < argc)
+            workers_count = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "-p") == 0 && arg+1 < argc)
+            pipeline_workers = std::atoi(argv[++arg]);
+        else
+            algo.setThreadsCount(std::atoi(argv[arg]));
+    }
+    if (pipeline_workers > 0) {
+        Pipeline<PipelineCase> pipeline(pipeline_workers);
+        pipeline.Run(input.ReadInt());
+    } else if (workers_count > 1) {
+        run_tests_batch(workers_count);
+    } else {
+        run_tests_loop();
+    }
     return 0;
 }